@@ -74,7 +74,23 @@ void AdcCommand::parse(const string& aLine, bool nmdc /* = false */) {
 	bool featureSet = false;
 	bool fromSet = nmdc; // $ADCxxx never have a from CID...
 
+	if(i < len) {
+		parameters.reserve(std::count(buf + i, buf + len, ' ') + 1);
+	}
+
 	while(i < len) {
+		// Copy the characters that don't need any handling at once
+		auto runEnd = i;
+		while(runEnd < len && buf[runEnd] != ' ' && buf[runEnd] != '\\')
+			++runEnd;
+
+		if(runEnd != i) {
+			cur.append(buf + i, runEnd - i);
+			i = runEnd;
+			if(i == len)
+				break;
+		}
+
 		switch(buf[i]) {
 		case '\\':
 			++i;
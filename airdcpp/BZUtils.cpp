@@ -22,6 +22,10 @@
 #include "Exception.h"
 #include "ResourceManager.h"
 
+#include "concurrency.h"
+
+#include <thread>
+
 namespace dcpp {
 	
 BZFilter::BZFilter() {
@@ -101,4 +105,244 @@ bool UnBZFilter::operator()(const void* in, size_t& insize, void* out, size_t& o
 	return err == BZ_OK;
 }
 
+namespace {
+
+const uint64_t BLOCK_MAGIC = 0x314159265359ULL;
+const uint64_t STREAM_END_MAGIC = 0x177245385090ULL;
+const uint64_t MAGIC_MASK = 0xFFFFFFFFFFFFULL;
+const int MAGIC_BITS = 48;
+
+// Stream header ("BZh" + block size)
+const uint64_t HEADER_BITS = 4 * 8;
+
+// Block headers may also appear inside the compressed data by accident
+const size_t MAX_MERGED_BLOCKS = 4;
+
+inline int getBit(const ByteVector& aData, uint64_t aBit) noexcept {
+	return (aData[static_cast<size_t>(aBit / 8)] >> (7 - aBit % 8)) & 1;
+}
+
+inline uint32_t getBits32(const ByteVector& aData, uint64_t aBit) noexcept {
+	uint32_t ret = 0;
+	for (int i = 0; i < 32; ++i) {
+		ret = (ret << 1) | getBit(aData, aBit + i);
+	}
+
+	return ret;
+}
+
+class BitWriter {
+public:
+	explicit BitWriter(ByteVector& aOut) noexcept : out(aOut) { }
+
+	void writeBits(uint64_t aValue, int aCount) noexcept {
+		for (int i = aCount - 1; i >= 0; --i) {
+			writeBit((aValue >> i) & 1);
+		}
+	}
+
+	// Copy bits from an arbitrary bit offset
+	void copyBits(const ByteVector& aData, uint64_t aStart, uint64_t aEnd) noexcept {
+		while (aStart < aEnd && bitCount != 0) {
+			writeBit(getBit(aData, aStart++));
+		}
+
+		// The output is byte aligned now
+		const auto shift = aStart % 8;
+		for (; aEnd - aStart >= 8; aStart += 8) {
+			auto pos = static_cast<size_t>(aStart / 8);
+			out.push_back(shift == 0 ? aData[pos] : static_cast<uint8_t>((aData[pos] << shift) | (aData[pos + 1] >> (8 - shift))));
+		}
+
+		while (aStart < aEnd) {
+			writeBit(getBit(aData, aStart++));
+		}
+	}
+
+	void flush() noexcept {
+		if (bitCount > 0) {
+			out.push_back(static_cast<uint8_t>(cur << (8 - bitCount)));
+			cur = 0;
+			bitCount = 0;
+		}
+	}
+private:
+	void writeBit(int aBit) noexcept {
+		cur = static_cast<uint8_t>((cur << 1) | aBit);
+		if (++bitCount == 8) {
+			out.push_back(cur);
+			cur = 0;
+			bitCount = 0;
+		}
+	}
+
+	ByteVector& out;
+	uint8_t cur = 0;
+	int bitCount = 0;
+};
+
+}
+
+ParallelUnBZInputStream::ParallelUnBZInputStream(const ByteVector& aData) noexcept : data(aData) {
+	if (data.size() < 14 || data[0] != 'B' || data[1] != 'Z' || data[2] != 'h' || data[3] < '1' || data[3] > '9') {
+		return;
+	}
+
+	level = data[3];
+
+	// Block headers aren't byte aligned so all bit offsets must be checked
+	vector<uint64_t> starts;
+	bool innerStreamEnd = false;
+	uint64_t window = 0;
+	for (size_t i = HEADER_BITS / 8; i < data.size(); ++i) {
+		window = (window << 8) | data[i];
+		for (int shift = 7; shift >= 0; --shift) {
+			auto end = static_cast<uint64_t>(i + 1) * 8 - shift;
+			if (end < HEADER_BITS + MAGIC_BITS) {
+				continue;
+			}
+
+			auto value = (window >> shift) & MAGIC_MASK;
+			if (value == BLOCK_MAGIC) {
+				starts.push_back(end - MAGIC_BITS);
+			} else if (value == STREAM_END_MAGIC) {
+				if ((end + 32 + 7) / 8 == data.size()) {
+					// The real end marker is followed only by the combined CRC and padding
+					streamEnd = end - MAGIC_BITS;
+				} else {
+					// Concatenated streams (or a false match inside the compressed data)
+					innerStreamEnd = true;
+				}
+			}
+		}
+	}
+
+	// Concatenated streams have their own headers and combined CRCs between the blocks, use the serial decompressor for those
+	if (streamEnd == 0 || innerStreamEnd || starts.empty() || starts.front() != HEADER_BITS) {
+		return;
+	}
+
+	starts.erase(remove_if(starts.begin(), starts.end(), [this](uint64_t aStart) { return aStart >= streamEnd; }), starts.end());
+	blockStarts.swap(starts);
+}
+
+uint64_t ParallelUnBZInputStream::getBlockEnd(size_t aBlock) const noexcept {
+	return aBlock + 1 < blockStarts.size() ? blockStarts[aBlock + 1] : streamEnd;
+}
+
+bool ParallelUnBZInputStream::decompressSegment(const ByteVector& aData, char aLevel, const Segment& aSegment, ByteVector& out_) noexcept {
+	const auto offset = aSegment.startBit / 8 * 8;
+	if ((aSegment.endBit - offset + 7) / 8 > aData.size()) {
+		return false;
+	}
+
+	return decompressBits(aData, aLevel, aSegment.startBit - offset, aSegment.endBit - offset, out_);
+}
+
+bool ParallelUnBZInputStream::decompressBits(const ByteVector& aData, char aLevel, uint64_t aStartBit, uint64_t aEndBit, ByteVector& out_) noexcept {
+	// Create a stream with the header, block and the end marker
+	// The combined CRC of a stream with a single block equals the CRC of the block
+	ByteVector stream { 'B', 'Z', 'h', static_cast<uint8_t>(aLevel) };
+	stream.reserve(static_cast<size_t>((aEndBit - aStartBit) / 8) + 16);
+
+	BitWriter writer(stream);
+	writer.copyBits(aData, aStartBit, aEndBit);
+	writer.writeBits(STREAM_END_MAGIC, MAGIC_BITS);
+	writer.writeBits(getBits32(aData, aStartBit + MAGIC_BITS), 32);
+	writer.flush();
+
+	bz_stream zs;
+	memzero(&zs, sizeof(zs));
+	if (BZ2_bzDecompressInit(&zs, 0, 0) != BZ_OK) {
+		return false;
+	}
+
+	zs.next_in = (char*)stream.data();
+	zs.avail_in = static_cast<unsigned int>(stream.size());
+
+	const size_t chunkSize = (aLevel - '0') * 100000;
+	size_t outPos = 0;
+	int err = BZ_OK;
+	for (;;) {
+		out_.resize(outPos + chunkSize);
+		zs.next_out = (char*)&out_[outPos];
+		zs.avail_out = static_cast<unsigned int>(chunkSize);
+
+		err = BZ2_bzDecompress(&zs);
+		outPos = out_.size() - zs.avail_out;
+
+		// Truncated data?
+		if (err != BZ_OK || (zs.avail_in == 0 && zs.avail_out != 0)) {
+			break;
+		}
+	}
+
+	BZ2_bzDecompressEnd(&zs);
+
+	out_.resize(outPos);
+	return err == BZ_STREAM_END;
+}
+
+size_t ParallelUnBZInputStream::decompressMerged(size_t aBlock, ByteVector& out_) const {
+	for (auto last = aBlock + 1; last < blockStarts.size() && last - aBlock < MAX_MERGED_BLOCKS; ++last) {
+		if (decompressBlock(blockStarts[aBlock], getBlockEnd(last), out_)) {
+			return last + 1;
+		}
+	}
+
+	throw Exception(STRING(DECOMPRESSION_ERROR));
+}
+
+void ParallelUnBZInputStream::decompressNext() {
+	const auto firstBlock = nextBlock;
+	const auto count = min(blockStarts.size() - firstBlock, static_cast<size_t>(max(std::thread::hardware_concurrency(), 1u)) * 2);
+
+	vector<pair<bool, ByteVector>> results(count);
+	vector<size_t> indexes(count);
+	iota(indexes.begin(), indexes.end(), 0);
+
+	parallel_for_each(indexes.begin(), indexes.end(), [&](size_t i) {
+		auto block = firstBlock + i;
+		results[i].first = decompressBlock(blockStarts[block], getBlockEnd(block), results[i].second);
+	});
+
+	while (nextBlock < firstBlock + count) {
+		auto& result = results[nextBlock - firstBlock];
+		if (result.first) {
+			addOutput(nextBlock, nextBlock + 1, move(result.second));
+		} else {
+			// The block was split from a false header
+			ByteVector merged;
+			addOutput(nextBlock, decompressMerged(nextBlock, merged), move(merged));
+		}
+	}
+}
+
+void ParallelUnBZInputStream::addOutput(size_t aFirstBlock, size_t aNextBlock, ByteVector&& aData) noexcept {
+	segments.push_back({ blockStarts[aFirstBlock], getBlockEnd(aNextBlock - 1), outputTotal, aData.size() });
+	outputTotal += aData.size();
+
+	output.push_back(move(aData));
+	nextBlock = aNextBlock;
+}
+
+size_t ParallelUnBZInputStream::read(void* buf, size_t& len) {
+	while (output.empty() || outputPos == output.front().size()) {
+		if (!output.empty()) {
+			output.pop_front();
+			outputPos = 0;
+		} else if (nextBlock < blockStarts.size()) {
+			decompressNext();
+		} else {
+			len = 0;
+			return 0;
+		}
+	}
+
+	len = min(len, output.front().size() - outputPos);
+	memcpy(buf, &output.front()[outputPos], len);
+	outputPos += len;
+	return len;
+}
+
 } // namespace dcpp
\ No newline at end of file
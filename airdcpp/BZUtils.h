@@ -21,6 +21,8 @@
 
 #include <bzlib.h>
 
+#include "Streams.h"
+
 namespace dcpp {
 
 class BZFilter {
@@ -57,6 +59,72 @@ private:
 	bz_stream zs;
 };
 
+/**
+ * Decompresses a complete bzip2 stream in memory by splitting it into blocks that
+ * are decompressed concurrently. The output is returned in the original order.
+ */
+class ParallelUnBZInputStream : public InputStream {
+public:
+	// The data must be kept alive as long as the stream is being used
+	explicit ParallelUnBZInputStream(const ByteVector& aData) noexcept;
+
+	// Returns false if the data can't be split into blocks (e.g. concatenated streams or too few blocks)
+	// UnBZFilter must be used in that case
+	bool isSplit() const noexcept { return blockStarts.size() > 1; }
+
+	size_t read(void* buf, size_t& len) override;
+
+	// Independently decompressable part of the stream (a block or blocks merged because of false headers)
+	struct Segment {
+		uint64_t startBit;
+		uint64_t endBit;
+
+		// Position in the decompressed data
+		uint64_t outStart;
+		uint64_t outSize;
+	};
+
+	// Complete only after all data has been read
+	const vector<Segment>& getSegments() const noexcept { return segments; }
+	char getLevel() const noexcept { return level; }
+
+	// Decompress a single segment for random access
+	// aData must contain the compressed stream starting from the byte aSegment.startBit / 8
+	static bool decompressSegment(const ByteVector& aData, char aLevel, const Segment& aSegment, ByteVector& out_) noexcept;
+private:
+	// Decompress the next blocks concurrently
+	void decompressNext();
+
+	// Decompress bits between the offsets as a separate stream containing a single block
+	bool decompressBlock(uint64_t aStartBit, uint64_t aEndBit, ByteVector& out_) const noexcept {
+		return decompressBits(data, level, aStartBit, aEndBit, out_);
+	}
+
+	static bool decompressBits(const ByteVector& aData, char aLevel, uint64_t aStartBit, uint64_t aEndBit, ByteVector& out_) noexcept;
+	void addOutput(size_t aFirstBlock, size_t aNextBlock, ByteVector&& aData) noexcept;
+
+	// Returns the next block after the merged block
+	size_t decompressMerged(size_t aBlock, ByteVector& out_) const;
+
+	uint64_t getBlockEnd(size_t aBlock) const noexcept;
+
+	const ByteVector& data;
+	char level = 0;
+
+	// Bit offsets of the block headers
+	vector<uint64_t> blockStarts;
+	uint64_t streamEnd = 0;
+
+	size_t nextBlock = 0;
+
+	// Decompressed data waiting to be read
+	deque<ByteVector> output;
+	size_t outputPos = 0;
+
+	vector<Segment> segments;
+	uint64_t outputTotal = 0;
+};
+
 } // namespace dcpp
 
 #endif // !defined(DCPLUSPLUS_DCPP_BZUTILS_H)
\ No newline at end of file
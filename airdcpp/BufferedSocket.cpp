@@ -201,7 +201,6 @@ void BufferedSocket::threadRead() {
 		throw SocketException(STRING(CONNECTION_CLOSED));
 	}
 
-	string::size_type pos = 0;
 	// always uncompressed data
 	string l;
 	int bufpos = 0, total = left;
@@ -212,8 +211,8 @@ void BufferedSocket::threadRead() {
 					const int BUF_SIZE = 1024;
 					// Special to autodetect nmdc connections...
 					boost::scoped_array<char> buffer(new char[BUF_SIZE]);
-					l = line;
 					// decompress all input data and store in l.
+					l.clear();
 					while (left) {
 						size_t in = BUF_SIZE;
 						size_t used = left;
@@ -228,14 +227,7 @@ void BufferedSocket::threadRead() {
 						}
 					}
 					// process all lines
-					while ((pos = l.find(separator)) != string::npos) {
-                       	if(pos > 0) // check empty (only pipe) command and don't waste cpu with it ;o)
-							fire(BufferedSocketListener::Line(), l.substr(0, pos));
-						l.erase (0, pos + 1 /* separator char */);
-					}
-					// store remainder
-					line = l;
-
+					parseLines(l.data(), l.size());
 					break;
 				}
 			case MODE_LINE:
@@ -247,22 +239,16 @@ void BufferedSocket::threadRead() {
 						separator = '\n';
 					}
 				}
-				l = line + string ((char*)&inbuf[bufpos], left);
-				while ((pos = l.find(separator)) != string::npos) {
-	                if(pos > 0) // check empty (only pipe) command and don't waste cpu with it ;o)
-						fire(BufferedSocketListener::Line(), l.substr(0, pos));
-					l.erase (0, pos + 1 /* separator char */);
-					if (l.length() < (size_t)left) left = l.length();
+				{
+					auto handled = static_cast<int>(parseLines((const char*)&inbuf[bufpos], left));
 					if (mode != MODE_LINE) {
-						// we changed mode; remainder of l is invalid.
-						l.clear();
-						bufpos = total - left;
-						break;
+						// we changed mode; the rest of the buffer is handled in the new mode
+						bufpos += handled;
+						left -= handled;
+					} else {
+						left = 0;
 					}
 				}
-				if (pos == string::npos) 
-					left = 0;
-				line = l;
 				break;
 			case MODE_DATA:
 				while(left > 0) {
@@ -294,6 +280,41 @@ void BufferedSocket::threadRead() {
 	}
 }
 
+size_t BufferedSocket::parseLines(const char* aData, size_t aLen) {
+	const auto startMode = mode;
+	const auto end = aData + aLen;
+
+	auto cur = aData;
+	while (cur != end) {
+		auto sep = static_cast<const char*>(memchr(cur, separator, end - cur));
+		if (!sep) {
+			// store remainder
+			line.append(cur, end);
+			break;
+		}
+
+		if (line.empty()) {
+			lineBuf.assign(cur, sep);
+		} else {
+			// the beginning of the line was received earlier
+			line.append(cur, sep);
+			lineBuf.swap(line);
+			line.clear();
+		}
+
+		cur = sep + 1 /* separator char */;
+
+		if (!lineBuf.empty()) // check empty (only pipe) command and don't waste cpu with it ;o)
+			fire(BufferedSocketListener::Line(), lineBuf);
+
+		if (mode != startMode) {
+			break;
+		}
+	}
+
+	return cur - aData;
+}
+
 void BufferedSocket::threadSendFile(InputStream* file) {
 	if(state != RUNNING)
 		return;
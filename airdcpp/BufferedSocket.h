@@ -162,6 +162,7 @@ private:
 	int64_t dataBytes;
 	size_t rollback;
 	string line;
+	string lineBuf; // reused for the lines that are passed to listeners
 	ByteVector inbuf;
 	ByteVector writeBuf;
 	ByteVector sendBuf;
@@ -176,6 +177,10 @@ private:
 	void threadConnect(const Socket::AddressInfo& aAddr, const string& aPort, const string& localPort, NatRoles natRole, bool proxy);
 	void threadAccept();
 	void threadRead();
+
+	// Fires the complete lines and appends the remainder to the current line
+	// Returns the number of bytes handled (parsing stops if a listener changes the mode)
+	size_t parseLines(const char* aData, size_t aLen);
 	void threadSendFile(InputStream* is);
 	void threadSendData();
 
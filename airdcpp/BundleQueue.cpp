@@ -352,6 +352,8 @@ void BundleQueue::addBundleItem(const QueueItemPtr& aQI, const BundlePtr& aBundl
 	if (!aQI->isDownloaded()) {
 		queueSize += aQI->getSize();
 	}
+
+	bloomCache.add(aQI->getTTH());
 }
 
 void BundleQueue::removeBundleItem(const QueueItemPtr& aQI, bool aDownloadFinished) noexcept {
@@ -384,6 +386,25 @@ void BundleQueue::removeBundleItem(const QueueItemPtr& aQI, bool aDownloadFinish
 		queueSize -= aQI->getSize();
 		dcassert(queueSize >= 0);
 	}
+
+	if (!aDownloadFinished) {
+		// Finished files remain in the bundle
+		bloomCache.setDirty();
+	}
+}
+
+void BundleQueue::getBloom(HashBloom& bloom_) const noexcept {
+	bloomCache.get(bloom_, [this](HashBloom& aBloom) {
+		for (const auto& b : bundles | map_values) {
+			for (const auto& q : b->getQueueItems()) {
+				aBloom.add(q->getTTH());
+			}
+
+			for (const auto& q : b->getFinishedFiles()) {
+				aBloom.add(q->getTTH());
+			}
+		}
+	});
 }
 
 void BundleQueue::removeBundle(const BundlePtr& aBundle) noexcept{
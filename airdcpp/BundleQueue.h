@@ -24,6 +24,7 @@
 
 #include "Bundle.h"
 #include "DupeType.h"
+#include "HashBloom.h"
 #include "HintedUser.h"
 #include "PrioritySearchQueue.h"
 #include "SortedVector.h"
@@ -66,6 +67,9 @@ public:
 
 	size_t getTotalFiles() const noexcept;
 
+	// Add the queued and finished bundle files
+	void getBloom(HashBloom& bloom_) const noexcept;
+
 	void addBundle(const BundlePtr& aBundle) noexcept;
 
 	BundlePtr findBundle(QueueToken bundleToken) const noexcept;
@@ -115,6 +119,8 @@ private:
 	Bundle::TokenMap bundles;
 
 	int64_t queueSize = 0;
+
+	mutable HashBloomCache bloomCache;
 };
 
 } // namespace dcpp
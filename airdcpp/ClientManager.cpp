@@ -854,61 +854,83 @@ void ClientManager::userCommand(const HintedUser& user, const UserCommand& uc, P
 }
 
 bool ClientManager::sendUDP(AdcCommand& cmd, const CID& aCID, bool aNoCID /*false*/, bool aNoPassive /*false*/, const string& aKey /*Util::emptyString*/, const string& aHubUrl /*Util::emptyString*/) noexcept {
+	vector<AdcCommand> commands { cmd };
+	return sendUDP(commands, aCID, aNoCID, aNoPassive, aKey, aHubUrl);
+}
+
+bool ClientManager::sendUDP(vector<AdcCommand>& aCommands, const CID& aCID, bool aNoCID /*false*/, bool aNoPassive /*false*/, const string& aKey /*Util::emptyString*/, const string& aHubUrl /*Util::emptyString*/) noexcept {
 	auto u = findOnlineUser(aCID, aHubUrl);
 	if (!u) {
 		return false;
 	}
 
-	if (cmd.getType() == AdcCommand::TYPE_UDP && !u->getIdentity().isUdpActive()) {
-		if (u->getUser()->isNMDC() || aNoPassive) {
-			return false;
-		}
-
-		cmd.setType(AdcCommand::TYPE_DIRECT);
-		cmd.setTo(u->getIdentity().getSID());
-		u->getClient()->send(cmd);
-	} else {
-		try {
-			COMMAND_DEBUG(cmd.toString(), DebugManager::TYPE_CLIENT_UDP, DebugManager::OUTGOING, u->getIdentity().getIp() + ":" + u->getIdentity().getUdpPort());
-			auto cmdStr = aNoCID ? cmd.toString() : cmd.toString(getMe()->getCID());
-			if (!aKey.empty() && Encoder::isBase32(aKey.c_str())) {
-				uint8_t keyChar[16];
-				Encoder::fromBase32(aKey.c_str(), keyChar, 16);
-
-				uint8_t ivd[16] = { };
-
-				// prepend 16 random bytes to message
-				RAND_bytes(ivd, 16);
-				cmdStr.insert(0, (char*)ivd, 16);
-					
-				// use PKCS#5 padding to align the message length to the cypher block size (16)
-				uint8_t pad = 16 - (cmdStr.length() & 15);
-				cmdStr.append(pad, (char)pad);
-
-				// encrypt it
-				uint8_t* out = new uint8_t[cmdStr.length()];
-				memset(ivd, 0, 16);
-				int aLen = cmdStr.length();
-
-				AES_KEY key;
-				AES_set_encrypt_key(keyChar, 128, &key);
-				AES_cbc_encrypt((unsigned char*)cmdStr.c_str(), out, cmdStr.length(), &key, ivd, AES_ENCRYPT);
-
-				dcassert((aLen & 15) == 0);
-
-				cmdStr.clear();
-				cmdStr.insert(0, (char*)out, aLen);
-				delete[] out;
+	StringList datagrams;
+	for (auto& cmd: aCommands) {
+		if (cmd.getType() == AdcCommand::TYPE_UDP && !u->getIdentity().isUdpActive()) {
+			if (u->getUser()->isNMDC() || aNoPassive) {
+				return false;
 			}
-			udp.writeTo(u->getIdentity().getIp(), u->getIdentity().getUdpPort(), cmdStr);
-		} catch(const SocketException&) {
-			dcdebug("Socket exception sending ADC UDP command\n");
+
+			cmd.setType(AdcCommand::TYPE_DIRECT);
+			cmd.setTo(u->getIdentity().getSID());
+			u->getClient()->send(cmd);
+			continue;
 		}
+
+		COMMAND_DEBUG(cmd.toString(), DebugManager::TYPE_CLIENT_UDP, DebugManager::OUTGOING, u->getIdentity().getIp() + ":" + u->getIdentity().getUdpPort());
+		datagrams.push_back(aNoCID ? cmd.toString() : cmd.toString(getMe()->getCID()));
+	}
+
+	if (datagrams.empty()) {
+		return true;
+	}
+
+	if (!aKey.empty() && Encoder::isBase32(aKey.c_str())) {
+		encryptUDP(datagrams, aKey);
+	}
+
+	try {
+		udp.writeTo(u->getIdentity().getIp(), u->getIdentity().getUdpPort(), datagrams);
+	} catch(const SocketException&) {
+		dcdebug("Socket exception sending ADC UDP command\n");
 	}
 
 	return true;
 }
 
+void ClientManager::encryptUDP(StringList& datagrams_, const string& aKey) noexcept {
+	uint8_t keyChar[16];
+	Encoder::fromBase32(aKey.c_str(), keyChar, 16);
+
+	AES_KEY key;
+	AES_set_encrypt_key(keyChar, 128, &key);
+
+	// 16 random bytes will be prepended to each message
+	ByteVector prefixes(datagrams_.size() * 16);
+	RAND_bytes(&prefixes[0], static_cast<int>(prefixes.size()));
+
+	auto prefix = prefixes.data();
+	string out;
+	for (auto& data: datagrams_) {
+		// use PKCS#5 padding to align the message length to the cypher block size (16)
+		uint8_t pad = 16 - (data.length() & 15);
+
+		out.resize(16 + data.length() + pad);
+		memcpy(&out[0], prefix, 16);
+		memcpy(&out[16], data.data(), data.length());
+		memset(&out[16 + data.length()], pad, pad);
+
+		dcassert((out.length() & 15) == 0);
+
+		// encrypt it in place
+		uint8_t ivd[16] = { };
+		AES_cbc_encrypt((const unsigned char*)out.data(), (unsigned char*)&out[0], out.length(), &key, ivd, AES_ENCRYPT);
+
+		data.swap(out);
+		prefix += 16;
+	}
+}
+
 void ClientManager::infoUpdated() noexcept {
 	RLock l(cs);
 	for (auto c: clients | map_values) {
@@ -986,8 +1008,11 @@ void ClientManager::on(ClientListener::NmdcSearch, Client* aClient, const string
 				if(port.empty()) 
 					port = "412";
 
+				StringList datagrams;
 				for(const auto& sr: l)
-					udp.writeTo(ip, port, sr->toSR(*aClient));
+					datagrams.push_back(sr->toSR(*aClient));
+
+				udp.writeTo(ip, port, datagrams);
 
 			} catch(...) {
 				dcdebug("Search caught error\n");
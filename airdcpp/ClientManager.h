@@ -218,6 +218,9 @@ public:
 	
 	bool sendUDP(AdcCommand& c, const CID& to, bool aNoCID = false, bool aNoPassive = false, const string& aEncryptionKey = Util::emptyString, const string& aHubUrl = Util::emptyString) noexcept;
 
+	// Sends multiple commands to the same user with as few socket writes as possible
+	bool sendUDP(vector<AdcCommand>& aCommands, const CID& to, bool aNoCID = false, bool aNoPassive = false, const string& aEncryptionKey = Util::emptyString, const string& aHubUrl = Util::emptyString) noexcept;
+
 	bool connect(const UserPtr& aUser, const string& aToken, bool aAllowUrlChange, string& lastError_, string& hubHint_, bool& isProtocolError_, ConnectionType type = CONNECTION_TYPE_LAST) const noexcept;
 	bool privateMessageHooked(const HintedUser& aUser, const OutgoingChatMessage& aMessage, string& error_, bool aEcho = true) noexcept;
 	void userCommand(const HintedUser& aUser, const UserCommand& uc, ParamMap& params_, bool aCompatibility) noexcept;
@@ -261,6 +264,9 @@ private:
 	UserPtr me;
 
 	Socket udp;
+
+	// Encrypts the datagrams for searches with a key (SUDP)
+	static void encryptUDP(StringList& datagrams_, const string& aKey) noexcept;
 	
 	CID pid;
 	uint64_t lastOfflineUserCleanup;
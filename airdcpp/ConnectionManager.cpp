@@ -28,6 +28,7 @@
 #include "QueueManager.h"
 #include "ResourceManager.h"
 #include "ScopedFunctor.h"
+#include "TransferCompression.h"
 #include "UploadManager.h"
 #include "UserConnection.h"
 
@@ -621,6 +622,8 @@ void ConnectionManager::on(AdcCommand::SUP, UserConnection* aSource, const AdcCo
 				aSource->setFlag(UserConnection::FLAG_SUPPORTS_XML_BZLIST);
 			} else if(feat == UserConnection::FEATURE_ZLIB_GET) {
 				aSource->setFlag(UserConnection::FLAG_SUPPORTS_ZLIB_GET);
+			} else if(feat == UserConnection::FEATURE_ZSTD_GET) {
+				aSource->setFlag(UserConnection::FLAG_SUPPORTS_ZSTD_GET);
 			} else if(feat == UserConnection::FEATURE_ADC_BZIP) {
 				aSource->setFlag(UserConnection::FLAG_SUPPORTS_XML_BZLIST);
 			} else if(feat == UserConnection::FEATURE_ADC_TIGR) {
@@ -643,10 +646,7 @@ void ConnectionManager::on(AdcCommand::SUP, UserConnection* aSource, const AdcCo
 	}
 
 	if(aSource->isSet(UserConnection::FLAG_INCOMING)) {
-		StringList defFeatures = adcFeatures;
-		if(SETTING(COMPRESS_TRANSFERS)) {
-			defFeatures.push_back("AD" + UserConnection::FEATURE_ZLIB_GET);
-		}
+		auto defFeatures = getAdcFeatures();
 		aSource->sup(defFeatures);
 	} else {
 		aSource->inf(true, aSource->isSet(UserConnection::FLAG_MCN1) ? AirUtil::getSlotsPerUser(false) : 0);
@@ -654,6 +654,18 @@ void ConnectionManager::on(AdcCommand::SUP, UserConnection* aSource, const AdcCo
 	aSource->setState(UserConnection::STATE_INF);
 }
 
+StringList ConnectionManager::getAdcFeatures() const noexcept {
+	StringList defFeatures = adcFeatures;
+	if(SETTING(COMPRESS_TRANSFERS)) {
+		defFeatures.push_back("AD" + UserConnection::FEATURE_ZLIB_GET);
+		if (TransferCompression::isSupported(TransferCompression::CODEC_ZSTD)) {
+			defFeatures.push_back("AD" + UserConnection::FEATURE_ZSTD_GET);
+		}
+	}
+
+	return defFeatures;
+}
+
 void ConnectionManager::on(AdcCommand::STA, UserConnection*, const AdcCommand& /*cmd*/) noexcept {
 	
 }
@@ -670,10 +682,7 @@ void ConnectionManager::on(UserConnectionListener::Connected, UserConnection* aS
 		aSource->myNick(aSource->getToken());
 		aSource->lock(CryptoManager::getInstance()->getLock(), CryptoManager::getInstance()->getPk() + "Ref=" + aSource->getHubUrl());
 	} else {
-		StringList defFeatures = adcFeatures;
-		if(SETTING(COMPRESS_TRANSFERS)) {
-			defFeatures.push_back("AD" + UserConnection::FEATURE_ZLIB_GET);
-		}
+		auto defFeatures = getAdcFeatures();
 		aSource->sup(defFeatures);
 		aSource->send(AdcCommand(AdcCommand::SEV_SUCCESS, AdcCommand::SUCCESS, Util::emptyString).addParam("RF", aSource->getHubUrl()));
 	}
@@ -203,6 +203,9 @@ private:
 	StringList features;
 	StringList adcFeatures;
 
+	// Static features with the optional ones that depend on the current settings
+	StringList getAdcFeatures() const noexcept;
+
 	ExpectedMap expectedConnections;
 	typedef unordered_map<string, uint64_t> delayMap;
 	typedef delayMap::iterator delayIter;
@@ -28,16 +28,24 @@
 #include <boost/thread.hpp>
 #endif
 
+#include "LockProfiler.h"
+
 namespace dcpp {
 
+#ifdef LOCK_PROFILING
+#define PROFILED_LOCK(T) ProfiledLock<T>
+#else
+#define PROFILED_LOCK(T) T
+#endif
+
 typedef boost::detail::spinlock	FastCriticalSection;
-typedef std::lock_guard<boost::detail::spinlock> FastLock;
+typedef PROFILED_LOCK(std::lock_guard<boost::detail::spinlock>) FastLock;
 
 
 #ifndef _WIN32
 typedef boost::shared_mutex	SharedMutex;
-typedef boost::shared_lock<boost::shared_mutex> RLock;
-typedef boost::unique_lock<boost::shared_mutex> WLock;
+typedef PROFILED_LOCK(boost::shared_lock<boost::shared_mutex>) RLock;
+typedef PROFILED_LOCK(boost::unique_lock<boost::shared_mutex>) WLock;
 
 // A custom implementation is required for Semaphore
 class CriticalSection {
@@ -72,16 +80,16 @@ private:
 	T& cs;
 };
 
-typedef LockBase<CriticalSection> Lock;
+typedef PROFILED_LOCK(LockBase<CriticalSection>) Lock;
 
 #else
 
 typedef std::recursive_mutex	CriticalSection;
-typedef std::lock_guard<std::recursive_mutex> Lock;
+typedef PROFILED_LOCK(std::lock_guard<std::recursive_mutex>) Lock;
 
 typedef std::shared_mutex	SharedMutex;
-typedef std::shared_lock<std::shared_mutex> RLock;
-typedef std::unique_lock<std::shared_mutex> WLock;
+typedef PROFILED_LOCK(std::shared_lock<std::shared_mutex>) RLock;
+typedef PROFILED_LOCK(std::unique_lock<std::shared_mutex>) WLock;
 
 #endif
 
@@ -39,6 +39,7 @@
 #include "IgnoreManager.h"
 #include "Localization.h"
 #include "LogManager.h"
+#include "MetricsManager.h"
 #include "PrivateChatManager.h"
 #include "QueueManager.h"
 #include "RecentManager.h"
@@ -102,6 +103,7 @@ void startup(StepF stepF, MessageF messageF, Callback runWizard, ProgressF progr
 	RecentManager::newInstance();
 	IgnoreManager::newInstance();
 	TransferInfoManager::newInstance();
+	MetricsManager::newInstance();
 
 	if (moduleInitF) {
 		moduleInitF();
@@ -193,6 +195,7 @@ void shutdown(StepF stepF, ProgressF progressF, Callback moduleDestroyF) {
 
 	announce(STRING(SHUTTING_DOWN));
 
+	MetricsManager::deleteInstance();
 	TransferInfoManager::deleteInstance();
 	IgnoreManager::deleteInstance();
 	RecentManager::deleteInstance();
@@ -221,6 +224,10 @@ void shutdown(StepF stepF, ProgressF progressF, Callback moduleDestroyF) {
 	TimerManager::deleteInstance();
 	ResourceManager::deleteInstance();
 
+#ifdef LOCK_PROFILING
+	LockProfiler::dumpToFile(Util::getPath(Util::PATH_USER_LOCAL) + "LockProfile.txt");
+#endif
+
 	File::deleteFile(RUNNING_FLAG);
 #ifdef _WIN32	
 	::WSACleanup();
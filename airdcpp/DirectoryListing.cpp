@@ -24,6 +24,8 @@
 #include "AirUtil.h"
 #include "BZUtils.h"
 #include "ClientManager.h"
+#include "concurrency.h"
+#include "FileListIndex.h"
 #include "FilteredFile.h"
 #include "LogManager.h"
 #include "QueueManager.h"
@@ -32,8 +34,11 @@
 #include "SimpleXML.h"
 #include "SimpleXMLReader.h"
 #include "StringTokenizer.h"
+#include "Text.h"
 #include "User.h"
 
+#include <thread>
+
 
 namespace dcpp {
 
@@ -41,6 +46,82 @@ namespace dcpp {
 using boost::range::for_each;
 using boost::range::find_if;
 
+// Items are stored in the same order as in the list so that each directory has a continuous item range
+// Names aren't copied to the index as it's kept for as long as the list is open (they are converted to lower case when matching)
+class DirectoryListing::SearchIndex {
+public:
+	void addDirectory(Directory* aDir) noexcept {
+		directoryItems.emplace(aDir, items.size());
+		items.push_back({ aDir, nullptr, 0 });
+	}
+
+	void endDirectory(const Directory* aDir) noexcept {
+		auto i = directoryItems.find(aDir);
+		if (i != directoryItems.end()) {
+			items[i->second].end = items.size();
+		}
+	}
+
+	void addFile(const File::Ptr& aFile) noexcept {
+		items.push_back({ aFile->getParent(), aFile.get(), 0 });
+	}
+
+	// Item range of the directory (including the directory itself)
+	pair<size_t, size_t> getRange(const Directory* aDir) const noexcept {
+		auto i = directoryItems.find(aDir);
+		if (i == directoryItems.end()) {
+			// Root
+			return { 0, items.size() };
+		}
+
+		return { i->second, items[i->second].end };
+	}
+
+	// Same matching as with Directory::search
+	void match(size_t aStart, size_t aEnd, SearchQuery& aQuery, OrderedStringSet& results_) const noexcept {
+		const auto& patterns = aQuery.include.getPatterns();
+		const Directory* lastFileMatch = nullptr;
+		for (auto i = aStart; i < aEnd; ++i) {
+			const auto& item = items[i];
+			if (!item.file) {
+				if (aQuery.itemType != SearchQuery::TYPE_FILE) {
+					const auto nameLower = Text::toLower(item.directory->getName());
+					if (all_of(patterns.begin(), patterns.end(), [&](const StringSearch::Pattern& p) { return p.matchLower(nameLower) != string::npos; }) &&
+						aQuery.matchesSize(item.directory->getTotalSize(false))) {
+						results_.insert(item.directory->getParent()->getAdcPath());
+					}
+				}
+			} else if (item.directory != lastFileMatch && aQuery.itemType != SearchQuery::TYPE_DIRECTORY &&
+				aQuery.matchesFileLower(Text::toLower(item.file->getName()), item.file->getSize(), item.file->getRemoteDate())) {
+
+				lastFileMatch = item.directory;
+				results_.insert(item.directory->getAdcPath());
+			}
+		}
+	}
+
+	void matchTTH(size_t aStart, size_t aEnd, const TTHValue& aTTH, OrderedStringSet& results_) const noexcept {
+		for (auto i = aStart; i < aEnd; ++i) {
+			const auto& item = items[i];
+			if (item.file && item.file->getTTH() == aTTH) {
+				results_.insert(item.directory->getAdcPath());
+			}
+		}
+	}
+private:
+	struct Item {
+		// Parent directory for files
+		Directory* directory;
+		const File* file;
+
+		// Directories: end of the subtree range
+		size_t end;
+	};
+
+	vector<Item> items;
+	unordered_map<const Directory*, size_t> directoryItems;
+};
+
 DirectoryListing::DirectoryListing(const HintedUser& aUser, bool aPartial, const string& aFileName, bool aIsClientView, bool aIsOwnList) : 
 	TrackableDownloadItem(aIsOwnList || (!aPartial && Util::fileExists(aFileName))), // API requires the download state to be set correctly
 	hintedUser(aUser), root(Directory::create(nullptr, ADC_ROOT_STR, Directory::TYPE_INCOMPLETE_NOCHILD, 0)), partialList(aPartial), isOwnList(aIsOwnList), fileName(aFileName),
@@ -234,29 +315,100 @@ DirectoryListing::Directory::Ptr DirectoryListing::createBaseDirectory(const str
 	return cur;
 }
 
+// Compressed lists smaller than this aren't worth splitting
+#define PARALLEL_DECOMPRESSION_MIN_SIZE 4*1024*1024
+
+// Browsed lists larger than this are kept on disk
+#define LAZY_LOADING_MIN_SIZE 8*1024*1024
+
+// Maximum number of files and directories to keep loaded from lazily loaded lists
+#define LAZY_MAX_LOADED_ITEMS 200000
+
+// Search index is built for browsed lists larger than this
+#define SEARCH_INDEX_MIN_SIZE 1024*1024
+
+// Number of index items matched by a single worker
+#define SEARCH_CHUNK_ITEMS 64*1024
+
+// Number of chunks matched before letting other list tasks to run
+#define SEARCH_BATCH_CHUNKS 16
+
+// Minimum number of hashes to sort per thread
+#define SORT_CHUNK_MIN_SIZE 64*1024
+
 void DirectoryListing::loadFile() {
+	resetLazyState();
+	resetSearchIndex();
+
 	if (isOwnList) {
 		loadShareDirectory(ADC_ROOT_STR, true);
 	} else {
-
-		// For now, we detect type by ending...
-		string ext = Util::getFileExt(fileName);
-
 		dcpp::File ff(fileName, dcpp::File::READ, dcpp::File::OPEN, dcpp::File::BUFFER_AUTO);
 		root->setLastUpdateDate(ff.getLastModified());
-		if(Util::stricmp(ext, ".bz2") == 0) {
-			FilteredInputStream<UnBZFilter, false> f(&ff);
-			loadXML(f, false, ADC_ROOT_STR, ff.getLastModified());
-		} else if(Util::stricmp(ext, ".xml") == 0) {
-			loadXML(ff, false, ADC_ROOT_STR, ff.getLastModified());
+
+		if (isClientView && !matchADL && ff.getSize() >= LAZY_LOADING_MIN_SIZE) {
+			// Index the list and load the root only
+			lazyIndex = FileListIndex::create(fileName, [this] { return getClosing(); });
+			if (lazyIndex) {
+				loadLazyDirectory(ADC_ROOT_STR, false);
+				return;
+			}
+		}
+
+		if (isClientView && ff.getSize() >= SEARCH_INDEX_MIN_SIZE) {
+			searchIndex.reset(new SearchIndex());
+		}
+
+		readListFile(ff, fileName, [&](InputStream& aStream) {
+			loadXML(aStream, false, ADC_ROOT_STR, ff.getLastModified());
+		});
+	}
+}
+
+template<typename F>
+void DirectoryListing::readListFile(dcpp::File& aFile, const string& aPath, F&& aF) {
+	// For now, we detect type by ending...
+	string ext = Util::getFileExt(aPath);
+	if(Util::stricmp(ext, ".bz2") == 0) {
+		if (aFile.getSize() >= PARALLEL_DECOMPRESSION_MIN_SIZE) {
+			// Decompress large lists in memory using multiple threads
+			ByteVector data(static_cast<size_t>(aFile.getSize()));
+			size_t pos = 0;
+			while (pos < data.size()) {
+				size_t len = data.size() - pos;
+				if (aFile.read(&data[pos], len) == 0) {
+					break;
+				}
+
+				pos += len;
+			}
+
+			data.resize(pos);
+
+			{
+				ParallelUnBZInputStream stream(data);
+				if (stream.isSplit()) {
+					aF(stream);
+					return;
+				}
+			}
+
+			MemoryInputStream mis(move(data));
+			FilteredInputStream<UnBZFilter, false> f(&mis);
+			aF(f);
+		} else {
+			FilteredInputStream<UnBZFilter, false> f(&aFile);
+			aF(f);
 		}
+	} else if(Util::stricmp(ext, ".xml") == 0) {
+		aF(aFile);
 	}
 }
 
 class ListLoader : public SimpleXMLReader::CallBack {
 public:
-	ListLoader(DirectoryListing* aList, DirectoryListing::Directory* root, const string& aBase, bool aUpdating, const UserPtr& aUser, bool aCheckDupe, bool aPartialList, time_t aListDownloadDate) : 
-	  list(aList), cur(root), base(aBase), inListing(false), updating(aUpdating), user(aUser), checkDupe(aCheckDupe), partialList(aPartialList), dirsLoaded(0), listDownloadDate(aListDownloadDate) {
+	ListLoader(DirectoryListing* aList, DirectoryListing::Directory* root, const string& aBase, bool aUpdating, const UserPtr& aUser, bool aCheckDupe, bool aPartialList, time_t aListDownloadDate, DirectoryListing::SearchIndex* aSearchIndex) : 
+	  list(aList), cur(root), base(aBase), inListing(false), updating(aUpdating), user(aUser), checkDupe(aCheckDupe), partialList(aPartialList), dirsLoaded(0), listDownloadDate(aListDownloadDate), searchIndex(aSearchIndex) {
 	}
 
 	virtual ~ListLoader() { }
@@ -280,6 +432,8 @@ private:
 	bool partialList;
 	int dirsLoaded;
 	time_t listDownloadDate;
+
+	DirectoryListing::SearchIndex* searchIndex;
 };
 
 int DirectoryListing::loadPartialXml(const string& aXml, const string& aBase) {
@@ -288,7 +442,7 @@ int DirectoryListing::loadPartialXml(const string& aXml, const string& aBase) {
 }
 
 int DirectoryListing::loadXML(InputStream& is, bool aUpdating, const string& aBase, time_t aListDate) {
-	ListLoader ll(this, root.get(), aBase, aUpdating, getUser(), !isOwnList && isClientView && SETTING(DUPES_IN_FILELIST), partialList, aListDate);
+	ListLoader ll(this, root.get(), aBase, aUpdating, getUser(), !isOwnList && isClientView && SETTING(DUPES_IN_FILELIST), partialList || lazyIndex, aListDate, aUpdating ? nullptr : searchIndex.get());
 	try {
 		dcpp::SimpleXMLReader(&ll).parse(is);
 	} catch(SimpleXMLException& e) {
@@ -350,6 +504,9 @@ void ListLoader::startTag(const string& name, StringPairList& attribs, bool simp
 
 			auto f = make_shared<DirectoryListing::File>(cur, n, size, tth, checkDupe, Util::toTimeT(getAttrib(attribs, sDate, 3)));
 			cur->files.push_back(f);
+			if (searchIndex) {
+				searchIndex->addFile(f);
+			}
 		} else if(name == sDirectory) {
 			const string& n = getAttrib(attribs, sName, 0);
 			validateName(n);
@@ -383,6 +540,9 @@ void ListLoader::startTag(const string& name, StringPairList& attribs, bool simp
 					DirectoryListing::Directory::TYPE_NORMAL;
 
 				d = DirectoryListing::Directory::create(cur, n, type, listDownloadDate, (partialList && checkDupe), contentInfo, size, Util::toTimeT(date));
+				if (searchIndex) {
+					searchIndex->addDirectory(d.get());
+				}
 			} else {
 				if(!incomp) {
 					d->setComplete();
@@ -431,6 +591,10 @@ void ListLoader::startTag(const string& name, StringPairList& attribs, bool simp
 void ListLoader::endTag(const string& name) {
 	if(inListing) {
 		if(name == sDirectory) {
+			if (searchIndex) {
+				searchIndex->endDirectory(cur);
+			}
+
 			cur = cur->getParent();
 		} else if(name == sFileListing) {
 			// Cur should be the loaded base path now
@@ -600,6 +764,15 @@ void DirectoryListing::Directory::toBundleInfoList(const string& aTarget, Bundle
 }
 
 optional<DirectoryBundleAddInfo> DirectoryListing::createBundle(const Directory::Ptr& aDir, const string& aTarget, Priority aPriority, string& errorMsg_) noexcept {
+	if (lazyIndex && aDir->findIncomplete()) {
+		try {
+			loadLazyDirectory(aDir->getAdcPath(), true);
+		} catch (const Exception& e) {
+			errorMsg_ = e.getError();
+			return nullopt;
+		}
+	}
+
 	auto bundleFiles = aDir->toBundleInfoList();
 
 	try {
@@ -660,7 +833,7 @@ struct HashContained {
 	HashContained(const DirectoryListing::Directory::TTHSet& l) : tl(l) { }
 	const DirectoryListing::Directory::TTHSet& tl;
 	bool operator()(const DirectoryListing::File::Ptr& i) const {
-		return tl.count(i->getTTH()) > 0;
+		return tl.contains(i->getTTH());
 	}
 };
 
@@ -720,6 +893,14 @@ void DirectoryListing::Directory::getHashList(DirectoryListing::Directory::TTHSe
 	for(const auto& f: files) 
 		l.insert(f->getTTH());
 }
+
+void DirectoryListing::Directory::getHashList(vector<TTHValue>& l) const noexcept {
+	for (const auto& d: directories | map_values)
+		d->getHashList(l);
+
+	for (const auto& f: files)
+		l.push_back(f->getTTH());
+}
 	
 void DirectoryListing::getLocalPaths(const File::Ptr& f, StringList& ret) const {
 	if(f->getParent()->getAdls() && (f->getParent()->getParent() == root.get() || !isOwnList))
@@ -954,6 +1135,37 @@ void DirectoryListing::dispatch(DispatcherQueue::Callback& aCallback) noexcept {
 	}
 }
 
+// Sorts and removes duplicates, the array is split in chunks that are sorted and merged in parallel
+static void sortUniqueHashes(vector<TTHValue>& tths_) {
+	const auto chunkCount = max<size_t>(1, min<size_t>(std::thread::hardware_concurrency(), tths_.size() / SORT_CHUNK_MIN_SIZE));
+
+	vector<size_t> bounds;
+	for (size_t i = 0; i < chunkCount; ++i) {
+		bounds.push_back(tths_.size() * i / chunkCount);
+	}
+
+	bounds.push_back(tths_.size());
+
+	vector<size_t> chunks(chunkCount);
+	iota(chunks.begin(), chunks.end(), 0);
+	parallel_for_each(chunks.begin(), chunks.end(), [&](size_t i) {
+		sort(tths_.begin() + bounds[i], tths_.begin() + bounds[i + 1]);
+	});
+
+	for (size_t width = 1; width < chunkCount; width *= 2) {
+		vector<size_t> merges;
+		for (size_t i = 0; i + width < chunkCount; i += width * 2) {
+			merges.push_back(i);
+		}
+
+		parallel_for_each(merges.begin(), merges.end(), [&](size_t i) {
+			inplace_merge(tths_.begin() + bounds[i], tths_.begin() + bounds[i + width], tths_.begin() + bounds[min(i + width * 2, chunkCount)]);
+		});
+	}
+
+	tths_.erase(unique(tths_.begin(), tths_.end()), tths_.end());
+}
+
 void DirectoryListing::listDiffImpl(const string& aFile, bool aOwnList) {
 	int64_t start = GET_TICK();
 	if (isOwnList && partialList) {
@@ -962,13 +1174,99 @@ void DirectoryListing::listDiffImpl(const string& aFile, bool aOwnList) {
 		partialList = false;
 	}
 
-	DirectoryListing dirList(hintedUser, false, aFile, false, aOwnList);
-	dirList.loadFile();
+	disableLazyLoading();
+
+	// Content will be modified
+	resetSearchIndex();
 
-	root->filterList(dirList);
+	// Collect the hashes of both lists in parallel (the other list isn't loaded in memory)
+	vector<TTHValue> ownHashes, otherHashes;
+	{
+		std::exception_ptr error;
+		vector<int> tasks = { 0, 1 };
+		parallel_for_each(tasks.begin(), tasks.end(), [&](int aTask) {
+			if (aTask == 0) {
+				root->getHashList(ownHashes);
+				sortUniqueHashes(ownHashes);
+				return;
+			}
+
+			try {
+				getListHashes(aFile, aOwnList, otherHashes);
+				sortUniqueHashes(otherHashes);
+			} catch (...) {
+				error = std::current_exception();
+			}
+		});
+
+		if (error) {
+			std::rethrow_exception(error);
+		}
+	}
+
+	// Merge join
+	Directory::TTHSet common(min(ownHashes.size(), otherHashes.size()));
+	{
+		auto own = ownHashes.begin();
+		auto other = otherHashes.begin();
+		while (own != ownHashes.end() && other != otherHashes.end()) {
+			if (*own < *other) {
+				++own;
+			} else if (*other < *own) {
+				++other;
+			} else {
+				common.insert(*own);
+				++own;
+				++other;
+			}
+		}
+	}
+
+	dcdebug("DirectoryListing::listDiffImpl: %d common hashes (%d/%d), " I64_FMT " ms\n", static_cast<int>(common.size()), static_cast<int>(ownHashes.size()), static_cast<int>(otherHashes.size()), GET_TICK() - start);
+
+	root->filterList(common);
 	fire(DirectoryListingListener::LoadingFinished(), start, ADC_ROOT_STR, false);
 }
 
+// Collects the file hashes without building the directory tree
+class ListHashLoader : public SimpleXMLReader::CallBack {
+public:
+	ListHashLoader(const DirectoryListing& aList, vector<TTHValue>& tths_) noexcept : list(aList), tths(tths_) { }
+
+	void startTag(const string& aName, StringPairList& aAttribs, bool) {
+		if (list.getClosing()) {
+			throw AbortException();
+		}
+
+		if (aName == sFile) {
+			const auto& tth = getAttrib(aAttribs, sTTH, 2);
+			if (!tth.empty()) {
+				tths.emplace_back(tth);
+			}
+		}
+	}
+private:
+	const DirectoryListing& list;
+	vector<TTHValue>& tths;
+};
+
+void DirectoryListing::getListHashes(const string& aFile, bool aOwnList, vector<TTHValue>& tths_) const {
+	if (aOwnList) {
+		ShareManager::getInstance()->getProfileHashes(Util::toInt(aFile), tths_);
+		return;
+	}
+
+	dcpp::File ff(aFile, dcpp::File::READ, dcpp::File::OPEN, dcpp::File::BUFFER_SEQUENTIAL);
+	readListFile(ff, aFile, [&](InputStream& aStream) {
+		ListHashLoader loader(*this, tths_);
+		try {
+			SimpleXMLReader(&loader).parse(aStream);
+		} catch (SimpleXMLException& e) {
+			throw AbortException(e.getError());
+		}
+	});
+}
+
 void DirectoryListing::matchAdlImpl() {
 	fire(DirectoryListingListener::LoadingStarted(), false);
 
@@ -980,6 +1278,8 @@ void DirectoryListing::matchAdlImpl() {
 		setMatchADL(true);
 		loadFileImpl(ADC_ROOT_STR);
 	} else {
+		disableLazyLoading();
+
 		fire(DirectoryListingListener::UpdateStatusMessage(), CSTRING(MATCHING_ADL));
 		ADLSearchManager::getInstance()->matchListing(*this);
 		fire(DirectoryListingListener::LoadingFinished(), start, ADC_ROOT_STR, false);
@@ -997,6 +1297,19 @@ void DirectoryListing::loadFileImpl(const string& aInitialDir) {
 
 	loadFile();
 
+	if (lazyIndex && aInitialDir != ADC_ROOT_STR) {
+		try {
+			auto dir = loadLazyParents(aInitialDir);
+			if (!dir->isComplete()) {
+				loadLazyDirectory(aInitialDir, false);
+			}
+		} catch (const AbortException&) {
+			throw;
+		} catch (const Exception&) {
+			// The directory doesn't exist, root will be opened instead
+		}
+	}
+
 	if (matchADL) {
 		fire(DirectoryListingListener::UpdateStatusMessage(), CSTRING(MATCHING_ADL));
 		ADLSearchManager::getInstance()->matchListing(*this);
@@ -1034,6 +1347,7 @@ void DirectoryListing::updateCurrentLocation(const Directory::Ptr& aCurrentDirec
 
 void DirectoryListing::searchImpl(const SearchPtr& aSearch) noexcept {
 	searchResults.clear();
+	searchToken++;
 
 	fire(DirectoryListingListener::SearchStarted());
 
@@ -1052,6 +1366,30 @@ void DirectoryListing::searchImpl(const SearchPtr& aSearch) noexcept {
 		TimerManager::getInstance()->addListener(this);
 
 		directSearch.reset(new DirectSearch(hintedUser, aSearch));
+	} else if (lazyIndex) {
+		// Search from the disk
+		const auto dir = lazyIndex->findDirectory(aSearch->path);
+		if (dir != -1) {
+			try {
+				lazyIndex->search(dir, *curSearch, searchResults);
+			} catch (const Exception& e) {
+				dcdebug("DirectoryListing: failed to search the list (%s)\n", e.getError().c_str());
+			}
+		}
+
+		endSearch(false);
+	} else if (searchIndex) {
+		const auto dir = findDirectory(aSearch->path);
+		if (!dir) {
+			endSearch(false);
+		} else if (curSearch->root) {
+			auto range = searchIndex->getRange(dir.get());
+			searchIndex->matchTTH(range.first, range.second, *curSearch->root, searchResults);
+			endSearch(false);
+		} else {
+			auto range = searchIndex->getRange(dir.get());
+			matchSearchIndex(searchToken, range.first, range.second);
+		}
 	} else {
 		const auto dir = findDirectory(aSearch->path);
 		if (dir) {
@@ -1062,6 +1400,68 @@ void DirectoryListing::searchImpl(const SearchPtr& aSearch) noexcept {
 	}
 }
 
+void DirectoryListing::matchSearchIndex(uint64_t aSearchToken, size_t aStartItem, size_t aEndItem) noexcept {
+	for (;;) {
+		if (aSearchToken != searchToken || !curSearch || !searchIndex) {
+			// Replaced by a new search or the list was reloaded
+			return;
+		}
+
+		// Match the next batch in parallel, each chunk gets its own copy of the query as it stores the matching state
+		const auto batchEnd = min(aEndItem, aStartItem + SEARCH_CHUNK_ITEMS * SEARCH_BATCH_CHUNKS);
+
+		vector<size_t> chunks;
+		for (auto pos = aStartItem; pos < batchEnd; pos += SEARCH_CHUNK_ITEMS) {
+			chunks.push_back(pos);
+		}
+
+		vector<OrderedStringSet> chunkResults(chunks.size());
+		vector<size_t> indexes(chunks.size());
+		iota(indexes.begin(), indexes.end(), 0);
+
+		try {
+			parallel_for_each(indexes.begin(), indexes.end(), [&](size_t i) {
+				SearchQuery query(*curSearch);
+				searchIndex->match(chunks[i], min(chunks[i] + SEARCH_CHUNK_ITEMS, batchEnd), query, chunkResults[i]);
+			});
+		} catch (std::exception& e) {
+			dcdebug("DirectoryListing::matchSearchIndex: parallel search failed (%s)\n", e.what());
+		}
+
+		const auto hadResults = !searchResults.empty();
+		for (const auto& results: chunkResults) {
+			searchResults.insert(results.begin(), results.end());
+		}
+
+		if (batchEnd == aEndItem || searchResults.size() >= curSearch->maxResults) {
+			if (!hadResults) {
+				endSearch(false);
+			}
+
+			return;
+		}
+
+		if (!hadResults && !searchResults.empty()) {
+			// Open the first result while the search continues
+			curResult = searchResults.begin();
+			addDirectoryChangeTask(*curResult, false, true);
+		}
+
+		aStartItem = batchEnd;
+		if (isClientView) {
+			addAsyncTask([=] { matchSearchIndex(aSearchToken, batchEnd, aEndItem); });
+			return;
+		}
+	}
+}
+
+void DirectoryListing::resetSearchIndex() noexcept {
+	searchIndex.reset();
+
+	// Abort unfinished searches
+	searchToken++;
+}
+
 void DirectoryListing::loadPartialImpl(const string& aXml, const string& aBasePath, bool aBackgroundTask, const AsyncF& aCompletionF) {
 	if (!partialList)
 		return;
@@ -1106,6 +1506,13 @@ bool DirectoryListing::isLoaded() const noexcept {
 }
 
 void DirectoryListing::matchQueueImpl() noexcept {
+	try {
+		disableLazyLoading();
+	} catch (const Exception& e) {
+		fire(DirectoryListingListener::LoadingFailed(), e.getError());
+		return;
+	}
+
 	int matches = 0, newFiles = 0;
 	BundleList bundles;
 	QueueManager::getInstance()->matchListing(*this, matches, newFiles, bundles);
@@ -1168,6 +1575,15 @@ void DirectoryListing::changeDirectoryImpl(const string& aAdcPath, bool aReload,
 		// Directory may not exist when searching in partial lists 
 		// or when opening directories from search (or via the API) for existing filelists
 		dir = createBaseDirectory(aAdcPath);
+	} else if (lazyIndex) {
+		try {
+			dir = loadLazyParents(aAdcPath);
+		} catch (const Exception& e) {
+			fire(DirectoryListingListener::LoadingFailed(), e.getError());
+			return;
+		}
+
+		touchLazyDirectory(dir->getAdcPath());
 	} else {
 		dir = findDirectory(aAdcPath);
 		if (!dir) {
@@ -1185,7 +1601,22 @@ void DirectoryListing::changeDirectoryImpl(const string& aAdcPath, bool aReload,
 		fire(DirectoryListingListener::ChangeDirectory(), aAdcPath, aIsSearchChange);
 	}
 
-	if (!partialList || dir->getLoading() || (dir->isComplete() && !aReload)) {
+	if (lazyIndex) {
+		if (!dir->isComplete()) {
+			// Load the content from the disk
+			fire(DirectoryListingListener::LoadingStarted(), true);
+
+			try {
+				loadLazyDirectory(aAdcPath, false);
+			} catch (const Exception& e) {
+				fire(DirectoryListingListener::LoadingFailed(), e.getError());
+				return;
+			}
+
+			onLoadingFinished(0, aAdcPath, false);
+			evictLazyDirectories();
+		}
+	} else if (!partialList || dir->getLoading() || (dir->isComplete() && !aReload)) {
 		// No need to load anything
 	} else if (partialList) {
 		if (isOwnList || (getUser()->isOnline() || aForceQueue)) {
@@ -1223,6 +1654,113 @@ bool DirectoryListing::nextResult(bool prev) noexcept {
 	return true;
 }
 
+DirectoryListing::Directory::Ptr DirectoryListing::loadLazyParents(const string& aPath) {
+	auto cur = root;
+
+	const auto sl = StringTokenizer<string>(aPath, ADC_SEPARATOR).getTokens();
+	for (const auto& name: sl) {
+		if (!cur->isComplete()) {
+			loadLazyDirectory(cur->getAdcPath(), false);
+		}
+
+		auto i = cur->directories.find(&name);
+		if (i == cur->directories.end()) {
+			throw Exception(STRING(FILE_NOT_AVAILABLE));
+		}
+
+		cur = i->second;
+	}
+
+	return cur;
+}
+
+int DirectoryListing::loadLazyDirectory(const string& aPath, bool aRecursive) {
+	const auto index = lazyIndex->findDirectory(aPath);
+	if (index == -1) {
+		throw Exception(STRING(FILE_NOT_AVAILABLE));
+	}
+
+	auto dir = findDirectory(aPath);
+	if (dir) {
+		dir->clearAll();
+		removeLazyDirectories(aPath);
+	}
+
+	MemoryInputStream mis(lazyIndex->getPartialList(index, aRecursive));
+	auto dirsLoaded = loadXML(mis, true, aPath, root->getLastUpdateDate());
+
+	const auto& info = lazyIndex->getDirectory(index);
+	auto items = aRecursive ? info.totalFiles + info.totalDirectories : info.files + static_cast<int>(info.children.size());
+
+	lazyDirectories.push_back({ aPath, items });
+	lazyLoadedItems += items;
+	return dirsLoaded;
+}
+
+void DirectoryListing::disableLazyLoading() {
+	if (!lazyIndex) {
+		return;
+	}
+
+	loadLazyDirectory(ADC_ROOT_STR, true);
+	resetLazyState();
+}
+
+void DirectoryListing::touchLazyDirectory(const string& aPath) noexcept {
+	auto i = find_if(lazyDirectories.begin(), lazyDirectories.end(), [&aPath](const LazyDirectory& d) { return Util::stricmp(d.path, aPath) == 0; });
+	if (i != lazyDirectories.end()) {
+		lazyDirectories.splice(lazyDirectories.end(), lazyDirectories, i);
+	}
+}
+
+void DirectoryListing::removeLazyDirectories(const string& aPath) noexcept {
+	for (auto i = lazyDirectories.begin(); i != lazyDirectories.end();) {
+		if (AirUtil::isParentOrExactAdc(aPath, i->path)) {
+			lazyLoadedItems -= i->items;
+			i = lazyDirectories.erase(i);
+		} else {
+			++i;
+		}
+	}
+}
+
+void DirectoryListing::evictLazyDirectories() noexcept {
+	const auto currentPath = currentLocation.directory ? currentLocation.directory->getAdcPath() : ADC_ROOT_STR;
+
+	auto i = lazyDirectories.begin();
+	while (lazyLoadedItems > LAZY_MAX_LOADED_ITEMS && i != lazyDirectories.end()) {
+		if (AirUtil::isParentOrExactAdc(i->path, currentPath)) {
+			// Keep the current directory and its parents
+			++i;
+			continue;
+		}
+
+		auto dir = findDirectory(i->path);
+		auto index = lazyIndex->findDirectory(i->path);
+		if (dir && index != -1) {
+			const auto& info = lazyIndex->getDirectory(index);
+
+			dir->clearAll();
+			dir->setType(info.totalDirectories > 0 ? Directory::TYPE_INCOMPLETE_CHILD : Directory::TYPE_INCOMPLETE_NOCHILD);
+			dir->setContentInfo(DirectoryContentInfo(info.totalDirectories, info.totalFiles));
+			dir->setPartialSize(info.totalSize);
+		}
+
+		dcdebug("DirectoryListing: evicting %s\n", i->path.c_str());
+
+		// Subdirectories were removed as well
+		auto path = i->path;
+		removeLazyDirectories(path);
+		i = lazyDirectories.begin();
+	}
+}
+
+void DirectoryListing::resetLazyState() noexcept {
+	lazyIndex.reset();
+	lazyDirectories.clear();
+	lazyLoadedItems = 0;
+}
+
 void DirectoryListing::addDirectoryChangeTask(const string& aPath, bool aReload, bool aIsSearchChange, bool aForceQueue) noexcept {
 	addAsyncTask([=] {
 		changeDirectoryImpl(aPath, aReload, aIsSearchChange, aForceQueue);
@@ -30,6 +30,7 @@
 #include "DirectSearch.h"
 #include "DispatcherQueue.h"
 #include "DupeType.h"
+#include "FlatTTHSet.h"
 #include "GetSet.h"
 #include "HintedUser.h"
 #include "MerkleTree.h"
@@ -42,6 +43,7 @@
 
 namespace dcpp {
 
+class FileListIndex;
 class ListLoader;
 typedef uint32_t DirectoryListingToken;
 
@@ -96,7 +98,7 @@ public:
 		struct Sort { bool operator()(const Ptr& a, const Ptr& b) const; };
 
 		typedef std::vector<Ptr> List;
-		typedef unordered_set<TTHValue> TTHSet;
+		typedef FlatTTHSet TTHSet;
 		typedef map<const string*, Ptr, noCaseStringLess> Map;
 		
 		Map directories;
@@ -113,6 +115,7 @@ public:
 		void filterList(DirectoryListing& dirList) noexcept;
 		void filterList(TTHSet& l) noexcept;
 		void getHashList(TTHSet& l) const noexcept;
+		void getHashList(vector<TTHValue>& l) const noexcept;
 		void clearAdls() noexcept;
 		void clearAll() noexcept;
 
@@ -187,6 +190,9 @@ public:
 	void loadFile();
 	bool isLoaded() const noexcept;
 
+	// Large full lists are kept on disk and directories are loaded only when they are being browsed
+	bool isLazyLoaded() const noexcept { return !!lazyIndex; }
+
 
 	// Returns the number of loaded dirs
 	// Throws AbortException
@@ -318,6 +324,17 @@ private:
 
 	void endSearch(bool timedOut = false) noexcept;
 
+	// Flat index of full lists for searching
+	class SearchIndex;
+	unique_ptr<SearchIndex> searchIndex;
+	void resetSearchIndex() noexcept;
+
+	// Matches the index in batches so that other tasks (such as result browsing) can run between them
+	void matchSearchIndex(uint64_t aSearchToken, size_t aStartItem, size_t aEndItem) noexcept;
+
+	// Incremented for each new search to abort the unfinished ones
+	uint64_t searchToken = 0;
+
 	// Throws Exception, AbortException
 	int loadShareDirectory(const string& aPath, bool aRecurse = false);
 
@@ -327,6 +344,15 @@ private:
 	// Throws Exception, AbortException
 	void listDiffImpl(const string& aFile, bool aOwnList);
 
+	// Sorted hashes of all files in a list file or in a share profile
+	// Throws Exception, AbortException
+	void getListHashes(const string& aFile, bool aOwnList, vector<TTHValue>& tths_) const;
+
+	// Calls aF with the decompressed content of the list file
+	// Throws Exception
+	template<typename F>
+	static void readListFile(dcpp::File& aFile, const string& aPath, F&& aF);
+
 	// Throws Exception, AbortException
 	void loadFileImpl(const string& aInitialDir);
 	void searchImpl(const SearchPtr& aSearch) noexcept;
@@ -346,6 +372,36 @@ private:
 
 	unique_ptr<DirectSearch> directSearch;
 	DispatcherQueue tasks;
+
+	// Lazy loading of full lists
+
+	// Create the parents of the directory, returns the directory
+	// Throws Exception, AbortException
+	Directory::Ptr loadLazyParents(const string& aPath);
+
+	// Recursive loading will replace all existing content in the directory
+	// Throws Exception, AbortException
+	int loadLazyDirectory(const string& aPath, bool aRecursive);
+
+	// Load the whole list in memory (needed by operations that go through all content)
+	// Throws Exception, AbortException
+	void disableLazyLoading();
+
+	void touchLazyDirectory(const string& aPath) noexcept;
+	void removeLazyDirectories(const string& aPath) noexcept;
+	void evictLazyDirectories() noexcept;
+	void resetLazyState() noexcept;
+
+	unique_ptr<FileListIndex> lazyIndex;
+
+	struct LazyDirectory {
+		string path;
+		int items;
+	};
+
+	// Loaded directories, least recently used first
+	list<LazyDirectory> lazyDirectories;
+	int64_t lazyLoadedItems = 0;
 };
 
 inline bool operator==(const DirectoryListing::Directory::Ptr& a, const string& b) { return Util::stricmp(a->getName(), b) == 0; }
@@ -28,7 +28,6 @@
 #include "QueueItem.h"
 #include "SharedFileStream.h"
 #include "UserConnection.h"
-#include "ZUtils.h"
 
 namespace dcpp {
 
@@ -132,7 +131,7 @@ void Download::appendFlags(OrderedStringSet& flags_) const noexcept {
 	Transfer::appendFlags(flags_);
 }
 
-AdcCommand Download::getCommand(bool zlib, const string& mySID) const noexcept {
+AdcCommand Download::getCommand(bool zlib, bool zstd, const string& mySID) const noexcept {
 	AdcCommand cmd(AdcCommand::CMD_GET);
 	
 	cmd.addParam(Transfer::names[getType()]);
@@ -154,8 +153,15 @@ AdcCommand Download::getCommand(bool zlib, const string& mySID) const noexcept {
 	if(!mySID.empty()) //add requester's SID (mySID) to the filelist request, so he can find the hub we are calling from.
 		cmd.addParam("ID", mySID); 
 
-	if(zlib && SETTING(COMPRESS_TRANSFERS)) {
-		cmd.addParam("ZL1");
+	if(SETTING(COMPRESS_TRANSFERS)) {
+		// The uploader picks the codec (or no compression at all)
+		if (zlib) {
+			TransferCompression::addFlag(cmd, TransferCompression::CODEC_ZLIB);
+		}
+
+		if (zstd && TransferCompression::isSupported(TransferCompression::CODEC_ZSTD)) {
+			TransferCompression::addFlag(cmd, TransferCompression::CODEC_ZSTD);
+		}
 	}
 
 	if(isSet(Download::FLAG_RECURSIVE) && getType() == TYPE_PARTIAL_LIST) {
@@ -186,7 +192,7 @@ const string& Download::getDownloadTarget() const noexcept {
 	return (getTempTarget().empty() ? getPath() : getTempTarget());
 }
 
-void Download::open(int64_t bytes, bool z, bool hasDownloadedBytes) {
+void Download::open(int64_t bytes, TransferCompression::Codec aCodec, bool hasDownloadedBytes) {
 	if(getType() == Transfer::TYPE_FILE) {
 		auto target = getDownloadTarget();
 		auto fullSize = tt.getFileSize();
@@ -273,9 +279,9 @@ void Download::open(int64_t bytes, bool z, bool hasDownloadedBytes) {
 	// Check that we don't get too many bytes
 	output.reset(new LimitedOutputStream<true>(output.release(), bytes));
 
-	if(z) {
+	if(aCodec != TransferCompression::CODEC_NONE) {
 		setFlag(Download::FLAG_ZDOWNLOAD);
-		output.reset(new FilteredOutputStream<UnZFilter, true>(output.release()));
+		output.reset(TransferCompression::createDecompressor(aCodec, output.release()));
 	}
 }
 
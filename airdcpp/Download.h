@@ -29,6 +29,7 @@
 #include "MerkleTree.h"
 #include "TimerManager.h"
 #include "Transfer.h"
+#include "TransferCompression.h"
 
 namespace dcpp {
 
@@ -72,7 +73,7 @@ public:
 	string getTargetFileName() const noexcept;
 
 	/** Open the target output for writing */
-	void open(int64_t bytes, bool z, bool hasDownloadedBytes);
+	void open(int64_t bytes, TransferCompression::Codec aCodec, bool hasDownloadedBytes);
 
 	/** Release the target output */
 	void close();
@@ -82,7 +83,7 @@ public:
 	const string& getPFS() const { return pfs; }
 
 	/** @internal */
-	AdcCommand getCommand(bool zlib, const string& mySID) const noexcept;
+	AdcCommand getCommand(bool zlib, bool zstd, const string& mySID) const noexcept;
 	const unique_ptr<OutputStream>& getOutput() const { return output; }
 
 	GETSET(string, tempTarget, TempTarget);
@@ -331,7 +331,7 @@ void DownloadManager::checkDownloads(UserConnection* aConn) {
 	}
 
 	fire(DownloadManagerListener::Requesting(), d, !mySID.empty());
-	aConn->send(d->getCommand(aConn->isSet(UserConnection::FLAG_SUPPORTS_ZLIB_GET), mySID));
+	aConn->send(d->getCommand(aConn->isSet(UserConnection::FLAG_SUPPORTS_ZLIB_GET), aConn->isSet(UserConnection::FLAG_SUPPORTS_ZSTD_GET), mySID));
 }
 
 void DownloadManager::on(AdcCommand::SND, UserConnection* aSource, const AdcCommand& cmd) noexcept {
@@ -358,10 +358,10 @@ void DownloadManager::on(AdcCommand::SND, UserConnection* aSource, const AdcComm
 		return;
 	}
 
-	startData(aSource, start, bytes, cmd.hasFlag("ZL", 4));
+	startData(aSource, start, bytes, TransferCompression::parseCodec(cmd));
 }
 
-void DownloadManager::startData(UserConnection* aSource, int64_t start, int64_t bytes, bool z) {
+void DownloadManager::startData(UserConnection* aSource, int64_t start, int64_t bytes, TransferCompression::Codec aCodec) {
 	Download* d = aSource->getDownload();
 	dcassert(d);
 
@@ -386,7 +386,7 @@ void DownloadManager::startData(UserConnection* aSource, int64_t start, int64_t
 
 		{
 			RLock l (cs);
-			d->open(bytes, z, hasDownloadedBytes);
+			d->open(bytes, aCodec, hasDownloadedBytes);
 		}
 	} catch(const FileException& e) {
 		QueueManager::getInstance()->onDownloadError(d->getBundle(), e.getError());
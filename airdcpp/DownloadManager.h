@@ -30,6 +30,7 @@
 #include "CriticalSection.h"
 #include "Bundle.h"
 #include "MerkleTree.h"
+#include "TransferCompression.h"
 #include "Util.h"
 
 namespace dcpp {
@@ -99,7 +100,7 @@ private:
 
 	//typedef unordered_set<CID> CIDList;
 	void checkDownloads(UserConnection* aConn);
-	void startData(UserConnection* aSource, int64_t start, int64_t newSize, bool z);
+	void startData(UserConnection* aSource, int64_t start, int64_t newSize, TransferCompression::Codec aCodec);
 	void startBundle(UserConnection* aSource, BundlePtr aBundle);
 
 	void revive(UserConnection* uc);
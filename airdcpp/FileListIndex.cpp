@@ -0,0 +1,539 @@
+/*
+ * Copyright (C) 2012-2019 AirDC++ Project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+
+#include "stdinc.h"
+
+#include "FileListIndex.h"
+
+#include "File.h"
+#include "ResourceManager.h"
+#include "SearchQuery.h"
+#include "SimpleXML.h"
+#include "StringTokenizer.h"
+#include "Util.h"
+
+#define READ_BUFFER_SIZE 64*1024
+#define MAX_TAG_SIZE 64*1024
+#define MAX_CACHED_SEGMENTS 4
+
+namespace dcpp {
+
+const int FileListIndex::ROOT;
+
+namespace {
+
+// Splits the XML data into tags (content between '<' and '>'), the data may be passed in arbitrary chunks
+class TagScanner {
+public:
+	explicit TagScanner(uint64_t aStartPos) noexcept : pos(aStartPos) { }
+
+	// aF(const string& aTag, uint64_t aTagStart, uint64_t aTagEnd)
+	template<typename F>
+	void parse(const char* aBuf, size_t aLen, F&& aF) {
+		size_t i = 0;
+		while (i < aLen) {
+			if (state == STATE_TEXT) {
+				auto lt = static_cast<const char*>(memchr(aBuf + i, '<', aLen - i));
+				if (!lt) {
+					break;
+				}
+
+				i = lt - aBuf + 1;
+				tagStart = pos + i - 1;
+				tag.clear();
+				state = STATE_TAG;
+			} else if (state == STATE_TAG) {
+				auto j = i;
+				while (j < aLen && aBuf[j] != '>' && aBuf[j] != '"' && aBuf[j] != '\'') {
+					j++;
+				}
+
+				tag.append(aBuf + i, j - i);
+				if (j == aLen) {
+					i = j;
+				} else if (aBuf[j] == '>') {
+					i = j + 1;
+					state = STATE_TEXT;
+					aF(tag, tagStart, pos + i);
+				} else {
+					quote = aBuf[j];
+					tag += quote;
+					i = j + 1;
+					state = STATE_QUOTE;
+				}
+			} else {
+				auto q = static_cast<const char*>(memchr(aBuf + i, quote, aLen - i));
+				auto j = q ? static_cast<size_t>(q - aBuf) + 1 : aLen;
+				tag.append(aBuf + i, j - i);
+				i = j;
+				if (q) {
+					state = STATE_TAG;
+				}
+			}
+
+			if (tag.size() > MAX_TAG_SIZE) {
+				throw Exception("Invalid XML (tag too long)");
+			}
+		}
+
+		pos += aLen;
+	}
+private:
+	enum State {
+		STATE_TEXT,
+		STATE_TAG,
+		STATE_QUOTE
+	};
+
+	State state = STATE_TEXT;
+	string tag;
+	char quote = 0;
+
+	uint64_t tagStart = 0;
+	uint64_t pos;
+};
+
+// Element name of a start tag ("/Name" for end tags)
+string getElementName(const string& aTag) noexcept {
+	return aTag.substr(0, aTag.find_first_of(" \t\r\n/", 1));
+}
+
+// aF(const string& aName, string&& aValue) for each attribute of a tag
+template<typename F>
+void forEachAttribute(const string& aTag, F&& aF) {
+	auto i = aTag.find_first_of(" \t\r\n/");
+	while (i < aTag.size()) {
+		auto nameStart = aTag.find_first_not_of(" \t\r\n/", i);
+		if (nameStart == string::npos) {
+			return;
+		}
+
+		auto eq = aTag.find('=', nameStart);
+		if (eq == string::npos) {
+			return;
+		}
+
+		auto valueStart = aTag.find_first_of("\"'", eq);
+		if (valueStart == string::npos) {
+			return;
+		}
+
+		auto valueEnd = aTag.find(aTag[valueStart], valueStart + 1);
+		if (valueEnd == string::npos) {
+			return;
+		}
+
+		auto nameEnd = aTag.find_first_of(" \t\r\n=", nameStart);
+		auto value = aTag.substr(valueStart + 1, valueEnd - valueStart - 1);
+		SimpleXML::escape(value, true, true);
+		aF(aTag.substr(nameStart, nameEnd - nameStart), move(value));
+		i = valueEnd + 1;
+	}
+}
+
+void readFully(File& aFile, uint64_t aPos, void* aBuf, size_t aLen) {
+	aFile.setPos(aPos);
+
+	auto buf = static_cast<uint8_t*>(aBuf);
+	while (aLen > 0) {
+		auto len = aLen;
+		if (aFile.read(buf, len) == 0) {
+			throw Exception("The file list has been modified or it's corrupted");
+		}
+
+		buf += len;
+		aLen -= len;
+	}
+}
+
+}
+
+class FileListIndex::Builder {
+public:
+	Builder(FileListIndex& aIndex, const AbortF& aAbortF) noexcept : index(aIndex), abortF(aAbortF), scanner(0) {
+		index.directories.emplace_back();
+		stack.push_back(ROOT);
+	}
+
+	void parse(InputStream& aStream) {
+		vector<char> buf(READ_BUFFER_SIZE);
+		for (;;) {
+			if (abortF && abortF()) {
+				throw AbortException();
+			}
+
+			auto len = buf.size();
+			aStream.read(&buf[0], len);
+			if (len == 0) {
+				break;
+			}
+
+			scanner.parse(&buf[0], len, [this](const string& aTag, uint64_t aStart, uint64_t aEnd) {
+				onTag(aTag, aStart, aEnd);
+			});
+		}
+
+		if (!listingFound || stack.size() != 1) {
+			throw Exception("Invalid file list");
+		}
+
+		// Recursive information
+		auto& dirs = index.directories;
+		for (auto i = dirs.size() - 1; i > 0; --i) {
+			const auto& d = dirs[i];
+			auto& parent = dirs[d.parent];
+			parent.totalSize += d.totalSize;
+			parent.totalFiles += d.totalFiles;
+			parent.totalDirectories += d.totalDirectories + 1;
+		}
+	}
+private:
+	void onTag(const string& aTag, uint64_t aStart, uint64_t aEnd) {
+		if (aTag.empty() || aTag[0] == '?' || aTag[0] == '!') {
+			return;
+		}
+
+		auto& dirs = index.directories;
+		const auto cur = stack.back();
+		const auto name = getElementName(aTag);
+		if (name == "File") {
+			int64_t size = 0;
+			forEachAttribute(aTag, [&](const string& aName, string&& aValue) {
+				if (aName == "Size") {
+					size = Util::toInt64(aValue);
+				}
+			});
+
+			auto& d = dirs[cur];
+			d.files++;
+			d.totalFiles++;
+			d.totalSize += size;
+
+			// Merge ranges of consecutive files
+			if (lastFileDir == cur && !d.fileRanges.empty()) {
+				d.fileRanges.back().second = aEnd;
+			} else {
+				d.fileRanges.emplace_back(aStart, aEnd);
+			}
+
+			lastFileDir = cur;
+			return;
+		}
+
+		lastFileDir = -1;
+		if (name == "Directory") {
+			Directory d;
+			d.parent = cur;
+			d.contentStart = aEnd;
+			forEachAttribute(aTag, [&](const string& aName, string&& aValue) {
+				if (aName == "Name") {
+					d.name = move(aValue);
+				} else if (aName == "Date") {
+					d.date = Util::toTimeT(aValue);
+				}
+			});
+
+			if (d.name.empty() || d.name.find(ADC_SEPARATOR) != string::npos) {
+				throw Exception("Invalid directory name");
+			}
+
+			auto idx = static_cast<int>(dirs.size());
+			dirs[cur].children.push_back(idx);
+
+			if (aTag.back() == '/') {
+				d.contentEnd = aEnd;
+			} else {
+				stack.push_back(idx);
+			}
+
+			dirs.push_back(move(d));
+		} else if (name == "/Directory") {
+			if (stack.size() <= 1) {
+				throw Exception("Invalid file list");
+			}
+
+			dirs[cur].contentEnd = aStart;
+			stack.pop_back();
+		} else if (name == "FileListing") {
+			listingFound = true;
+			dirs[ROOT].contentStart = aEnd;
+			dirs[ROOT].contentEnd = aEnd;
+		} else if (name == "/FileListing") {
+			dirs[ROOT].contentEnd = aStart;
+		}
+	}
+
+	FileListIndex& index;
+	const AbortF& abortF;
+
+	TagScanner scanner;
+	vector<int> stack;
+	int lastFileDir = -1;
+	bool listingFound = false;
+};
+
+FileListIndex::FileListIndex(const string& aPath, bool aCompressed) noexcept : path(aPath), compressed(aCompressed) {
+
+}
+
+unique_ptr<FileListIndex> FileListIndex::create(const string& aPath, const AbortF& aAbortF) {
+	auto ext = Util::getFileExt(aPath);
+	if (Util::stricmp(ext, ".bz2") == 0) {
+		ByteVector data;
+		{
+			File f(aPath, File::READ, File::OPEN, File::BUFFER_SEQUENTIAL);
+			data.resize(static_cast<size_t>(f.getSize()));
+			if (!data.empty()) {
+				readFully(f, 0, &data[0], data.size());
+			}
+		}
+
+		ParallelUnBZInputStream stream(data);
+		if (!stream.isSplit()) {
+			return nullptr;
+		}
+
+		unique_ptr<FileListIndex> index(new FileListIndex(aPath, true));
+		Builder(*index, aAbortF).parse(stream);
+
+		index->segments = stream.getSegments();
+		index->level = stream.getLevel();
+		dcdebug("FileListIndex: %d directories, %d segments (%s)\n", static_cast<int>(index->directories.size()), static_cast<int>(index->segments.size()), aPath.c_str());
+		return index;
+	} else if (Util::stricmp(ext, ".xml") == 0) {
+		File f(aPath, File::READ, File::OPEN, File::BUFFER_SEQUENTIAL);
+
+		unique_ptr<FileListIndex> index(new FileListIndex(aPath, false));
+		Builder(*index, aAbortF).parse(f);
+		return index;
+	}
+
+	return nullptr;
+}
+
+int FileListIndex::findChild(int aDir, const string& aName) const noexcept {
+	for (auto c: directories[aDir].children) {
+		if (Util::stricmp(directories[c].name, aName) == 0) {
+			return c;
+		}
+	}
+
+	return -1;
+}
+
+int FileListIndex::findDirectory(const string& aAdcPath) const noexcept {
+	auto cur = ROOT;
+
+	const auto sl = StringTokenizer<string>(aAdcPath, ADC_SEPARATOR).getTokens();
+	for (const auto& name: sl) {
+		cur = findChild(cur, name);
+		if (cur == -1) {
+			break;
+		}
+	}
+
+	return cur;
+}
+
+string FileListIndex::getAdcPath(int aDir) const noexcept {
+	if (aDir == ROOT) {
+		return ADC_ROOT_STR;
+	}
+
+	const auto& d = directories[aDir];
+	return getAdcPath(d.parent) + d.name + ADC_SEPARATOR;
+}
+
+string FileListIndex::getPartialList(int aDir, bool aRecursive) const {
+	const auto& d = directories[aDir];
+
+	string tmp;
+	string xml = SimpleXML::utf8Header;
+	xml += "<FileListing Version=\"1\" Base=\"" + SimpleXML::escape(getAdcPath(aDir), tmp, true) + "\" BaseDate=\"" + Util::toString(d.date) + "\">\r\n";
+	if (aRecursive) {
+		xml += read(d.contentStart, d.contentEnd);
+	} else {
+		for (auto c: d.children) {
+			const auto& child = directories[c];
+			xml += "<Directory Name=\"" + SimpleXML::escape(child.name, tmp, true) + "\" Date=\"" + Util::toString(child.date) + "\" Size=\"" + Util::toString(child.totalSize);
+			if (child.totalFiles == 0 && child.totalDirectories == 0) {
+				// Nothing to load
+				xml += "\"/>\r\n";
+			} else {
+				xml += "\" Incomplete=\"1\" Directories=\"" + Util::toString(child.totalDirectories) + "\" Files=\"" + Util::toString(child.totalFiles) + "\"/>\r\n";
+			}
+		}
+
+		for (const auto& r: d.fileRanges) {
+			xml += read(r.first, r.second);
+			xml += "\r\n";
+		}
+	}
+
+	xml += "</FileListing>";
+	return xml;
+}
+
+void FileListIndex::search(int aDir, SearchQuery& aQuery, OrderedStringSet& results_) const {
+	const auto last = aDir + directories[aDir].totalDirectories;
+
+	// Directory names
+	for (auto i = aDir; i <= last; ++i) {
+		const auto& d = directories[i];
+		if (i != ROOT && aQuery.matchesDirectory(d.name) && aQuery.matchesSize(d.totalSize)) {
+			results_.insert(getAdcPath(d.parent));
+			if (results_.size() >= aQuery.maxResults) {
+				return;
+			}
+		}
+	}
+
+	// Files (ranges of a directory may not be consecutive if it has subdirectories)
+	struct Range {
+		uint64_t start;
+		uint64_t end;
+		int dir;
+	};
+
+	vector<Range> ranges;
+	for (auto i = aDir; i <= last; ++i) {
+		for (const auto& r: directories[i].fileRanges) {
+			ranges.push_back({ r.first, r.second, i });
+		}
+	}
+
+	sort(ranges.begin(), ranges.end(), [](const Range& a, const Range& b) { return a.start < b.start; });
+
+	vector<bool> matched(last - aDir + 1);
+	for (const auto& r: ranges) {
+		if (matched[r.dir - aDir]) {
+			continue;
+		}
+
+		auto data = read(r.start, r.end);
+
+		TagScanner scanner(r.start);
+		scanner.parse(data.c_str(), data.size(), [&](const string& aTag, uint64_t, uint64_t) {
+			if (matched[r.dir - aDir] || getElementName(aTag) != "File") {
+				return;
+			}
+
+			string name, tth;
+			int64_t size = 0;
+			time_t date = 0;
+			forEachAttribute(aTag, [&](const string& aName, string&& aValue) {
+				if (aName == "Name") {
+					name = move(aValue);
+				} else if (aName == "Size") {
+					size = Util::toInt64(aValue);
+				} else if (aName == "TTH") {
+					tth = move(aValue);
+				} else if (aName == "Date") {
+					date = Util::toTimeT(aValue);
+				}
+			});
+
+			if (aQuery.matchesFile(name, size, date, TTHValue(tth))) {
+				matched[r.dir - aDir] = true;
+			}
+		});
+
+		if (matched[r.dir - aDir]) {
+			results_.insert(getAdcPath(r.dir));
+			if (results_.size() >= aQuery.maxResults) {
+				return;
+			}
+		}
+	}
+}
+
+string FileListIndex::read(uint64_t aStart, uint64_t aEnd) const {
+	string ret;
+	if (aEnd <= aStart) {
+		return ret;
+	}
+
+	if (!compressed) {
+		File f(path, File::READ, File::OPEN, File::BUFFER_RANDOM);
+		ret.resize(static_cast<size_t>(aEnd - aStart));
+		readFully(f, aStart, &ret[0], ret.size());
+		return ret;
+	}
+
+	ret.reserve(static_cast<size_t>(aEnd - aStart));
+
+	// Find the segment containing the start position
+	auto i = upper_bound(segments.begin(), segments.end(), aStart, [](uint64_t aPos, const ParallelUnBZInputStream::Segment& aSegment) {
+		return aPos < aSegment.outStart;
+	});
+
+	dcassert(i != segments.begin());
+	for (--i; i != segments.end() && i->outStart < aEnd; ++i) {
+		const auto& data = getSegment(i - segments.begin());
+		auto from = max(aStart, i->outStart) - i->outStart;
+		auto to = min(aEnd, i->outStart + i->outSize) - i->outStart;
+		ret.append(reinterpret_cast<const char*>(&data[0]) + from, static_cast<size_t>(to - from));
+	}
+
+	if (ret.size() != aEnd - aStart) {
+		throw Exception(STRING(DECOMPRESSION_ERROR));
+	}
+
+	return ret;
+}
+
+const ByteVector& FileListIndex::getSegment(size_t aSegment) const {
+	{
+		auto i = find_if(segmentCache.begin(), segmentCache.end(), [aSegment](const pair<size_t, ByteVector>& p) { return p.first == aSegment; });
+		if (i != segmentCache.end()) {
+			if (i != segmentCache.begin()) {
+				auto p = move(*i);
+				segmentCache.erase(i);
+				segmentCache.push_front(move(p));
+			}
+
+			return segmentCache.front().second;
+		}
+	}
+
+	const auto& s = segments[aSegment];
+	auto startByte = s.startBit / 8;
+	auto endByte = (s.endBit + 7) / 8;
+
+	ByteVector data(static_cast<size_t>(endByte - startByte));
+	{
+		File f(path, File::READ, File::OPEN, File::BUFFER_RANDOM);
+		readFully(f, startByte, &data[0], data.size());
+	}
+
+	ByteVector out;
+	out.reserve(static_cast<size_t>(s.outSize));
+	if (!ParallelUnBZInputStream::decompressSegment(data, level, s, out) || out.size() != s.outSize) {
+		throw Exception(STRING(DECOMPRESSION_ERROR));
+	}
+
+	segmentCache.emplace_front(aSegment, move(out));
+	if (segmentCache.size() > MAX_CACHED_SEGMENTS) {
+		segmentCache.pop_back();
+	}
+
+	return segmentCache.front().second;
+}
+
+}
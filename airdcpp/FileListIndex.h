@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2012-2019 AirDC++ Project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef DCPLUSPLUS_DCPP_FILELISTINDEX_H_
+#define DCPLUSPLUS_DCPP_FILELISTINDEX_H_
+
+#include "BZUtils.h"
+#include "typedefs.h"
+
+namespace dcpp {
+
+class SearchQuery;
+
+// Directory structure of a full file list with the positions of directory content in the XML data
+// The list itself stays on disk and content is read from it only when needed. For bzip2 lists, the positions
+// of the compressed blocks are stored as well so that only the blocks containing the wanted data are decompressed.
+class FileListIndex {
+public:
+	typedef std::function<bool ()> AbortF;
+
+	struct Directory {
+		string name;
+		int parent = -1;
+		vector<int> children;
+		time_t date = 0;
+
+		// Content of the directory element (excluding the directory tags) in the decompressed data
+		uint64_t contentStart = 0;
+		uint64_t contentEnd = 0;
+
+		// Ranges with <File> elements of this directory in the decompressed data
+		vector<pair<uint64_t, uint64_t>> fileRanges;
+		int files = 0;
+
+		// Recursive
+		int64_t totalSize = 0;
+		int totalFiles = 0;
+		int totalDirectories = 0;
+	};
+
+	static const int ROOT = 0;
+
+	// Returns nullptr if the list doesn't support random access (e.g. bzip2 data that can't be split into blocks)
+	// Throws Exception, AbortException
+	static unique_ptr<FileListIndex> create(const string& aPath, const AbortF& aAbortF);
+
+	// Returns -1 if the directory doesn't exist
+	int findDirectory(const string& aAdcPath) const noexcept;
+	int findChild(int aDir, const string& aName) const noexcept;
+
+	const Directory& getDirectory(int aDir) const noexcept { return directories[aDir]; }
+	string getAdcPath(int aDir) const noexcept;
+	size_t getDirectoryCount() const noexcept { return directories.size(); }
+
+	// Partial file list with the files and incomplete child directories of the directory
+	// All content will be included in recursive lists
+	// Throws Exception
+	string getPartialList(int aDir, bool aRecursive) const;
+
+	// Same matching as with DirectoryListing::Directory::search (file information is read from the disk)
+	// Files are matched in the order they appear in the list so that the blocks are decompressed only once
+	// Throws Exception
+	void search(int aDir, SearchQuery& aQuery, OrderedStringSet& results_) const;
+private:
+	class Builder;
+
+	FileListIndex(const string& aPath, bool aCompressed) noexcept;
+
+	// Throws Exception
+	string read(uint64_t aStart, uint64_t aEnd) const;
+	const ByteVector& getSegment(size_t aSegment) const;
+
+	const string path;
+	const bool compressed;
+
+	// Directories in the same order as in the list (subdirectories of a directory follow it directly)
+	vector<Directory> directories;
+
+	// Compressed lists
+	vector<ParallelUnBZInputStream::Segment> segments;
+	char level = 0;
+
+	// Most recently used segments are at the front
+	mutable deque<pair<size_t, ByteVector>> segmentCache;
+};
+
+}
+
+#endif /* DCPLUSPLUS_DCPP_FILELISTINDEX_H_ */
@@ -25,7 +25,6 @@
 
 #include "DirectoryListing.h"
 #include "DupeType.h"
-#include "HashBloom.h"
 #include "QueueItem.h"
 #include "Util.h"
 
@@ -37,7 +36,6 @@ public:
 	FileQueue() { }
 	~FileQueue();
 
-	void getBloom(HashBloom& bloom) const noexcept;
 	typedef vector<pair<QueueItem::SourceConstIter, const QueueItemPtr> > PFSSourceList;
 
 	pair<QueueItem::StringMap::const_iterator, bool> add(QueueItemPtr& qi) noexcept;
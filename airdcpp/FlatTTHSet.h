@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2012-2019 AirDC++ Project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef DCPLUSPLUS_DCPP_FLATTTHSET_H_
+#define DCPLUSPLUS_DCPP_FLATTTHSET_H_
+
+#include "MerkleTree.h"
+#include "typedefs.h"
+
+namespace dcpp {
+
+// Open addressing hash set for TTHs
+// The hashes are stored in a single array (linear probing) instead of separately allocated nodes,
+// which keeps large sets compact and lookups cache friendly
+// Empty slots are marked with a zero hash, which is tracked separately if it gets inserted
+class FlatTTHSet {
+public:
+	FlatTTHSet() noexcept { }
+	explicit FlatTTHSet(size_t aExpectedSize) noexcept { reserve(aExpectedSize); }
+
+	// Returns false if the hash existed already
+	bool insert(const TTHValue& aTTH) noexcept {
+		if (isEmpty(aTTH)) {
+			if (hasEmpty) {
+				return false;
+			}
+
+			hasEmpty = true;
+			items++;
+			return true;
+		}
+
+		if ((items + 1) * 2 > slots.size()) {
+			rehash(max<size_t>(MIN_SLOTS, slots.size() * 2));
+		}
+
+		auto& slot = slots[findPos(aTTH)];
+		if (!isEmpty(slot)) {
+			return false;
+		}
+
+		slot = aTTH;
+		items++;
+		return true;
+	}
+
+	bool contains(const TTHValue& aTTH) const noexcept {
+		if (isEmpty(aTTH)) {
+			return hasEmpty;
+		}
+
+		if (slots.empty()) {
+			return false;
+		}
+
+		return !isEmpty(slots[findPos(aTTH)]);
+	}
+
+	// Reserve space for the wanted number of hashes (the load factor is kept below 0.5)
+	void reserve(size_t aSize) noexcept {
+		size_t wanted = MIN_SLOTS;
+		while (wanted < aSize * 2) {
+			wanted *= 2;
+		}
+
+		if (wanted > slots.size()) {
+			rehash(wanted);
+		}
+	}
+
+	void clear() noexcept {
+		slots.clear();
+		items = 0;
+		hasEmpty = false;
+	}
+
+	size_t size() const noexcept { return items; }
+	bool empty() const noexcept { return items == 0; }
+private:
+	static const size_t MIN_SLOTS = 16;
+
+	static bool isEmpty(const TTHValue& aTTH) noexcept {
+		return !aTTH;
+	}
+
+	// Position of the hash or the empty slot where it should be inserted
+	// The hash is random so its first bytes can be used as such
+	size_t findPos(const TTHValue& aTTH) const noexcept {
+		const auto mask = slots.size() - 1;
+		auto pos = std::hash<TTHValue>()(aTTH) & mask;
+		while (!isEmpty(slots[pos]) && slots[pos] != aTTH) {
+			pos = (pos + 1) & mask;
+		}
+
+		return pos;
+	}
+
+	// aSlots must be a power of two
+	void rehash(size_t aSlots) noexcept {
+		vector<TTHValue> old(aSlots, emptyValue());
+		old.swap(slots);
+
+		for (const auto& tth: old) {
+			if (!isEmpty(tth)) {
+				slots[findPos(tth)] = tth;
+			}
+		}
+	}
+
+	static TTHValue emptyValue() noexcept {
+		TTHValue ret;
+		memset(ret.data, 0, sizeof(ret.data));
+		return ret;
+	}
+
+	vector<TTHValue> slots;
+	size_t items = 0;
+	bool hasEmpty = false;
+};
+
+}
+
+#endif /* DCPLUSPLUS_DCPP_FLATTTHSET_H_ */
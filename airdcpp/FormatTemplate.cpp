@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2012-2019 AirDC++ Project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include "stdinc.h"
+
+#include "FormatTemplate.h"
+#include "Util.h"
+
+namespace dcpp {
+
+// The cache is emptied when this is exceeded (most format strings come from the settings)
+#define MAX_CACHED_TEMPLATES 256
+
+unordered_map<string, FormatTemplate::Ptr> FormatTemplate::cache;
+SharedMutex FormatTemplate::cs;
+
+FormatTemplate::FormatTemplate(const string& aFormat) noexcept {
+	auto addLiteral = [this](string&& aText) {
+		if (aText.empty()) {
+			return;
+		}
+
+		if (aText.find('%') != string::npos) {
+			hasTimeFormat = true;
+		}
+
+		literalLength += aText.size();
+		if (!segments.empty() && !segments.back().param) {
+			segments.back().text += aText;
+		} else {
+			segments.emplace_back(move(aText), false);
+		}
+	};
+
+	string::size_type i = 0, j, k;
+	while ((j = aFormat.find("%[", i)) != string::npos) {
+		if ((k = aFormat.find(']', j + 2)) == string::npos) {
+			break;
+		}
+
+		addLiteral(aFormat.substr(i, j - i));
+		segments.emplace_back(aFormat.substr(j + 2, k - j - 2), true);
+		paramCount++;
+
+		i = k + 1;
+	}
+
+	addLiteral(aFormat.substr(i));
+}
+
+FormatTemplate::Ptr FormatTemplate::get(const string& aFormat) noexcept {
+	{
+		RLock l(cs);
+		auto i = cache.find(aFormat);
+		if (i != cache.end()) {
+			return i->second;
+		}
+	}
+
+	auto formatTemplate = make_shared<const FormatTemplate>(aFormat);
+
+	{
+		WLock l(cs);
+		if (cache.size() >= MAX_CACHED_TEMPLATES) {
+			cache.clear();
+		}
+
+		cache.emplace(aFormat, formatTemplate);
+	}
+
+	return formatTemplate;
+}
+
+namespace {
+
+// used to parse the boost::variant params of the formatParams function.
+struct GetString : boost::static_visitor<string> {
+	string operator()(const string& s) const noexcept { return s; }
+	string operator()(const LazyParam& f) const noexcept { return f(); }
+};
+
+}
+
+string FormatTemplate::format(const ParamMap& aParams, FilterF aFilter, time_t aTime) const noexcept {
+	// Param values are copied as such if there is nothing for strftime to format
+	auto formatTime = aTime > 0 && hasTimeFormat;
+
+	string result;
+	result.reserve(literalLength + paramCount * 16);
+
+	for (const auto& s: segments) {
+		if (!s.param) {
+			result += s.text;
+			continue;
+		}
+
+		auto param = aParams.find(s.text);
+		if (param == aParams.end()) {
+			continue;
+		}
+
+		auto replacement = boost::apply_visitor(GetString(), param->second);
+		if (formatTime) {
+			// replace all % in params with %% for strftime
+			Util::replace("%", "%%", replacement);
+		}
+
+		if (aFilter) {
+			replacement = aFilter(replacement);
+		}
+
+		result += replacement;
+	}
+
+	if (formatTime) {
+		result = Util::formatTime(result, aTime);
+	}
+
+	return result;
+}
+
+}
@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2012-2019 AirDC++ Project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef DCPLUSPLUS_DCPP_FORMATTEMPLATE_H_
+#define DCPLUSPLUS_DCPP_FORMATTEMPLATE_H_
+
+#include "CriticalSection.h"
+#include "typedefs.h"
+
+namespace dcpp {
+
+// Format string for Util::formatParams that has been split into literal text and %[param] segments
+// Templates are parsed only once for each format string and they can be shared between threads
+class FormatTemplate {
+public:
+	typedef shared_ptr<const FormatTemplate> Ptr;
+	typedef string (*FilterF)(const string&);
+
+	explicit FormatTemplate(const string& aFormat) noexcept;
+
+	// Returns a cached template for the format string
+	static Ptr get(const string& aFormat) noexcept;
+
+	// Set aTime to 0 to avoid formating of time variables
+	string format(const ParamMap& aParams, FilterF aFilter, time_t aTime) const noexcept;
+
+	size_t getParamCount() const noexcept { return paramCount; }
+private:
+	struct Segment {
+		Segment(string&& aText, bool aParam) noexcept : text(move(aText)), param(aParam) { }
+
+		// Literal text or the param name
+		string text;
+		bool param;
+	};
+
+	vector<Segment> segments;
+	size_t literalLength = 0;
+	size_t paramCount = 0;
+
+	// Literal text contains strftime specifiers
+	bool hasTimeFormat = false;
+
+	static unordered_map<string, Ptr> cache;
+	static SharedMutex cs;
+};
+
+}
+
+#endif /* DCPLUSPLUS_DCPP_FORMATTEMPLATE_H_ */
@@ -43,7 +43,8 @@ uint64_t HashBloom::get_m(size_t n, size_t k) {
 
 void HashBloom::add(const TTHValue& tth) {
 	for(size_t i = 0; i < k; ++i) {
-		bloom[pos(tth, i)] = true;
+		auto p = pos(tth, i);
+		bloom[p / 64] |= 1ULL << (p % 64);
 	}
 }
 
@@ -52,7 +53,8 @@ bool HashBloom::match(const TTHValue& tth) const {
 		return false;
 	}
 	for(size_t i = 0; i < k; ++i) {
-		if(!bloom[pos(tth, i)]) {
+		auto p = pos(tth, i);
+		if(!(bloom[p / 64] & (1ULL << (p % 64)))) {
 			return false;
 		}
 	}
@@ -60,15 +62,38 @@ bool HashBloom::match(const TTHValue& tth) const {
 }
 
 void HashBloom::push_back(bool v) {
-	bloom.push_back(v);
+	if(bits % 64 == 0) {
+		bloom.push_back(0);
+	}
+
+	if(v) {
+		bloom.back() |= 1ULL << (bits % 64);
+	}
+	bits++;
 }
 
 void HashBloom::reset(size_t k_, size_t m, size_t h_) {
-	bloom.resize(m);
+	bloom.assign((m + 63) / 64, 0);
+	bits = m;
 	k = k_;
 	h = h_;
 }
 
+void HashBloom::clear() {
+	fill(bloom.begin(), bloom.end(), 0);
+}
+
+void HashBloom::merge(const HashBloom& aOther) {
+	dcassert(hasSameParams(aOther));
+	for(size_t i = 0; i < bloom.size(); ++i) {
+		bloom[i] |= aOther.bloom[i];
+	}
+}
+
+bool HashBloom::hasSameParams(const HashBloom& aOther) const {
+	return k == aOther.k && h == aOther.h && bits == aOther.bits;
+}
+
 size_t HashBloom::pos(const TTHValue& tth, size_t n) const {
 	if((n+1)*h > TTHValue::BITS) {
 		return 0;
@@ -86,14 +111,51 @@ size_t HashBloom::pos(const TTHValue& tth, size_t n) const {
 			x |= (1LL << i);
 		}
 	}
-	return x % bloom.size();
+	return x % bits;
 }
 
 void HashBloom::copy_to(ByteVector& v) const {
-	v.resize(bloom.size() / 8);
-	for(size_t i = 0; i < bloom.size(); ++i) {
-		v[i/8] |= bloom[i] << (i % 8);
+	v.assign(bits / 8, 0);
+	for(size_t i = 0; i < v.size(); ++i) {
+		v[i] = static_cast<uint8_t>(bloom[i / 8] >> ((i % 8) * 8));
 	}
 }
 
+void HashBloomCache::get(HashBloom& bloom_, const PopulateF& aPopulate) noexcept {
+	FastLock l(cs);
+	auto i = find_if(blooms.begin(), blooms.end(), [&](const unique_ptr<HashBloom>& aBloom) { 
+		return aBloom->hasSameParams(bloom_); 
+	});
+
+	unique_ptr<HashBloom> cached;
+	if (i != blooms.end()) {
+		cached = move(*i);
+		blooms.erase(i);
+	} else {
+		// Copy the parameters only
+		cached = make_unique<HashBloom>(bloom_);
+		cached->clear();
+		aPopulate(*cached);
+
+		if (blooms.size() == MAX_FILTERS) {
+			blooms.erase(blooms.begin());
+		}
+	}
+
+	bloom_.merge(*cached);
+	blooms.push_back(move(cached));
+}
+
+void HashBloomCache::add(const TTHValue& aTTH) noexcept {
+	FastLock l(cs);
+	for (auto& b: blooms) {
+		b->add(aTTH);
+	}
+}
+
+void HashBloomCache::setDirty() noexcept {
+	FastLock l(cs);
+	blooms.clear();
+}
+
 }
@@ -21,6 +21,8 @@
 
 #include "typedefs.h"
 
+#include "CriticalSection.h"
+
 namespace dcpp {
 /**
  * According to http://www.eecs.harvard.edu/~michaelm/NEWWORK/postscripts/BloomFilterSurvey.pdf
@@ -34,7 +36,7 @@ namespace dcpp {
  */
 class HashBloom {
 public:
-	HashBloom() : k(0), h(0) { }
+	HashBloom() : k(0), h(0), bits(0) { }
 
 	/** Return a suitable value for k based on n */
 	static size_t get_k(size_t n, size_t h);
@@ -45,15 +47,43 @@ public:
 	bool match(const TTHValue& tth) const;
 	void reset(size_t k, size_t m, size_t h);
 	void push_back(bool v);
+	void clear();
+
+	/** Add all items of a filter with identical parameters */
+	void merge(const HashBloom& aOther);
+	bool hasSameParams(const HashBloom& aOther) const;
 	
 	void copy_to(ByteVector& v) const;
 private:	
 	
 	size_t pos(const TTHValue& tth, size_t n) const;
 	
-	std::vector<bool> bloom;
+	// Bit i is stored in bit i % 64 of word i / 64
+	std::vector<uint64_t> bloom;
 	size_t k;
 	size_t h;
+	size_t bits;
+};
+
+/**
+ * Filters for the most recently requested parameter sets. The owner must add all new items 
+ * to the cache and mark it as dirty when items that may not exist anymore are removed.
+ */
+class HashBloomCache {
+public:
+	typedef std::function<void(HashBloom&)> PopulateF;
+
+	/** Merge the cached filter with the parameters of bloom_ into it, the filter is (re)built with aPopulate if needed */
+	void get(HashBloom& bloom_, const PopulateF& aPopulate) noexcept;
+
+	void add(const TTHValue& aTTH) noexcept;
+	void setDirty() noexcept;
+private:
+	static const size_t MAX_FILTERS = 4;
+
+	// Most recently used filters are at the end
+	std::vector<std::unique_ptr<HashBloom>> blooms;
+	FastCriticalSection cs;
 };
 
 }
@@ -23,6 +23,7 @@
 #include "File.h"
 #include "FileReader.h"
 #include "LogManager.h"
+#include "Metrics.h"
 #include "QueueManager.h"
 #include "ShareManager.h"
 #include "ResourceManager.h"
@@ -34,7 +35,7 @@
 
 #include "LevelDB.h"
 
-#define FILEINDEX_VERSION 1
+#define FILEINDEX_VERSION 2
 #define HASHDATA_VERSION 1
 
 namespace dcpp {
@@ -72,6 +73,16 @@ void HashManager::getFileInfo(const string& aFileLower, const string& aFileName,
 	}
 }
 
+optional<uint32_t> HashManager::getFileCRC32(const string& aFileLower, const string& aFileName) noexcept {
+	dcassert(Text::isLower(aFileLower));
+	HashedFile fi(File::getLastModified(aFileName), File::getSize(aFileName));
+	if (!store.checkTTH(aFileLower, fi)) {
+		return nullopt;
+	}
+
+	return fi.getCrc32();
+}
+
 bool HashManager::getTree(const TTHValue& root, TigerTree& tt) noexcept {
 	return store.getTree(root, tt);
 }
@@ -173,6 +184,7 @@ void HashManager::getFileTTH(const string& aFile, int64_t aSize, bool addStore,
 		}
 
 		TigerTree tt(bs);
+		CRC32Filter crc32;
 
 		auto start = GET_TICK();
 		int64_t tickHashed = 0;
@@ -180,6 +192,7 @@ void HashManager::getFileTTH(const string& aFile, int64_t aSize, bool addStore,
 		FileReader fr(true);
 		fr.read(aFile, [&](const void* buf, size_t n) -> bool {
 			tt.update(buf, n);
+			crc32(buf, n);
 
 			if (updateF) {
 				tickHashed += n;
@@ -203,6 +216,7 @@ void HashManager::getFileTTH(const string& aFile, int64_t aSize, bool addStore,
 
 		if (addStore && !aCancel) {
 			fi = HashedFile(tth_, timestamp, aSize);
+			fi.setCrc32(crc32.getValue());
 			store.addHashedFile(pathLower, tt, fi);
 		}
 	} else {
@@ -379,7 +393,8 @@ bool HashManager::HashStore::loadTree(const void* src, size_t len, const TTHValu
 }
 
 bool HashManager::HashStore::loadFileInfo(const void* src, size_t len, HashedFile& aFile) {
-	if (len != sizeof(HashedFile)+1)
+	// Version 1 entries don't have the CRC
+	if (len != getFileInfoSize(false) && len != getFileInfoSize(true))
 		return false;
 
 	char *p = (char*)src;
@@ -405,6 +420,14 @@ bool HashManager::HashStore::loadFileInfo(const void* src, size_t len, HashedFil
 	p += sizeof(int64_t);
 
 	aFile = HashedFile(root, timeStamp, fileSize);
+
+	if (len == getFileInfoSize(true)) {
+		p += sizeof(int64_t);
+
+		uint32_t crc;
+		memcpy(&crc, p, sizeof(uint32_t));
+		aFile.setCrc32(crc);
+	}
 	return true;
 }
 
@@ -425,11 +448,21 @@ void HashManager::HashStore::saveFileInfo(void *dest, const HashedFile& aFile) {
 
 	int64_t fileSize = aFile.getSize();
 	memcpy(p, &fileSize, sizeof(int64_t));
-	//p += sizeof(int64_t);
+
+	if (aFile.getCrc32()) {
+		p += sizeof(int64_t);
+
+		uint32_t crc = *aFile.getCrc32();
+		memcpy(p, &crc, sizeof(uint32_t));
+	}
 }
 
-uint32_t HashManager::HashStore::getFileInfoSize(const HashedFile& /*aTree*/) {
-	return sizeof(uint8_t) + sizeof(uint64_t) + sizeof(TTHValue) + sizeof(int64_t);
+uint32_t HashManager::HashStore::getFileInfoSize(const HashedFile& aFile) {
+	return getFileInfoSize(aFile.getCrc32() ? true : false);
+}
+
+uint32_t HashManager::HashStore::getFileInfoSize(bool aHasCrc) {
+	return sizeof(uint8_t) + sizeof(uint64_t) + sizeof(TTHValue) + sizeof(int64_t) + (aHasCrc ? sizeof(uint32_t) : 0);
 }
 
 void HashManager::HashStore::loadLegacyTree(File& f, int64_t aSize, int64_t aIndex, int64_t aBlockSize, size_t datLen, const TTHValue& root, TigerTree& tt) {
@@ -485,7 +518,7 @@ bool HashManager::HashStore::checkTTH(const string& aFileLower, HashedFile& fi_)
 
 bool HashManager::HashStore::getFileInfo(const string& aFileLower, HashedFile& fi_) noexcept {
 	try {
-		return fileDb->get((void*)aFileLower.c_str(), aFileLower.length(), sizeof(HashedFile), [&](void* aValue, size_t valueLen) {
+		return fileDb->get((void*)aFileLower.c_str(), aFileLower.length(), getFileInfoSize(true), [&](void* aValue, size_t valueLen) {
 			return loadFileInfo(aValue, valueLen, fi_);
 		});
 	} catch(const DbException& e) {
@@ -1156,9 +1189,8 @@ int HashManager::Hasher::run() {
 						lastRead = GET_TICK();
 					}
 					tt.update(buf, n);
-				
-					if(fileCRC)
-						crc32(buf, n);
+					crc32(buf, n);
+					Metrics::hashedBytes.add(n);
 
 					sizeLeft -= n;
 					uint64_t end = GET_TICK();
@@ -1184,12 +1216,14 @@ int HashManager::Hasher::run() {
 
 					dirFilesHashed++;
 					totalFilesHashed++;
+					Metrics::hashedFiles.add();
 				}
 
 				if(end > start) {
 					totalHashTime += (end - start);
 					dirHashTime += (end - start);
 					averageSpeed = size * 1000 / (end - start);
+					Metrics::hashSpeed.record(averageSpeed);
 				}
 
 				if(failed) {
@@ -1197,6 +1231,7 @@ int HashManager::Hasher::run() {
 					getInstance()->fire(HashManagerListener::FileFailed(), fname, fi);
 				} else {
 					fi = HashedFile(tt.getRoot(), timestamp, size);
+					fi.setCrc32(crc32.getValue());
 					getInstance()->hashDone(fname, pathLower, tt, averageSpeed, fi, hasherID);
 				}
 			} catch(const FileException& e) {
@@ -61,6 +61,10 @@ public:
 	// Throws HashException
 	void getFileInfo(const string& fileLower, const string& aFileName, HashedFile& aFileInfo);
 
+	// Returns the CRC32 calculated while hashing the file
+	// Nothing is returned if the file has been modified after hashing or the CRC isn't available
+	optional<uint32_t> getFileCRC32(const string& aFileLower, const string& aFileName) noexcept;
+
 	bool getTree(const TTHValue& root, TigerTree& tt) noexcept;
 
 	/** Return block size of the tree associated with root, or 0 if no such tree is in the store */
@@ -245,6 +249,7 @@ private:
 		static bool loadFileInfo(const void* src, size_t len, HashedFile& aFile);
 		static void saveFileInfo(void *dest, const HashedFile& aTree);
 		static uint32_t getFileInfoSize(const HashedFile& aTree);
+		static uint32_t getFileInfoSize(bool aHasCrc);
 	};
 
 	friend class HashLoader;
@@ -38,6 +38,9 @@ public:
 	GETSET(uint64_t, timeStamp, TimeStamp);
 	GETSET(int64_t, size, Size);
 
+	// Calculated while hashing (not available for files hashed with older versions)
+	GETSET(optional<uint32_t>, crc32, Crc32);
+
 	/*struct FileLess {
 		bool operator()(const HashedFilePtr& a, const HashedFilePtr& b) const { return (a->getFileName().compare(b->getFileName()) < 0); }
 	};
@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2012-2019 AirDC++ Project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef DCPLUSPLUS_DCPP_LAZYPARAM_H_
+#define DCPLUSPLUS_DCPP_LAZYPARAM_H_
+
+#include <new>
+#include <string>
+#include <type_traits>
+
+namespace dcpp {
+
+using std::string;
+
+// Lazily evaluated value for ParamMap
+// The callable is stored inline so that creating params never allocates memory. It must be trivially
+// copyable and small (capture references/pointers only) and it must outlive the formatting call.
+class LazyParam {
+public:
+	template<typename F, typename = typename std::enable_if<
+		!std::is_same<typename std::decay<F>::type, LazyParam>::value && !std::is_convertible<F, string>::value
+	>::type>
+	LazyParam(F&& aF) noexcept {
+		typedef typename std::decay<F>::type FuncT;
+		static_assert(sizeof(FuncT) <= sizeof(Storage) && alignof(FuncT) <= alignof(Storage), "Too many captures for a lazy param");
+		static_assert(std::is_trivially_copyable<FuncT>::value && std::is_trivially_destructible<FuncT>::value, "Lazy params may capture only references and pointers");
+
+		new (&storage) FuncT(std::forward<F>(aF));
+		invoker = [](const void* aData) -> string {
+			return (*static_cast<const FuncT*>(aData))();
+		};
+	}
+
+	string operator()() const {
+		return invoker(&storage);
+	}
+private:
+	typedef std::aligned_storage<4 * sizeof(void*), alignof(void*)>::type Storage;
+
+	Storage storage;
+	string (*invoker)(const void*);
+};
+
+}
+
+#endif /* DCPLUSPLUS_DCPP_LAZYPARAM_H_ */
@@ -21,6 +21,7 @@
 
 #include "File.h"
 #include "LogManager.h"
+#include "Metrics.h"
 #include "ResourceManager.h"
 #include "Thread.h"
 #include "Util.h"
@@ -127,6 +128,7 @@ LevelDB::~LevelDB() {
 
 void LevelDB::put(void* aKey, size_t keyLen, void* aValue, size_t valueLen, DbSnapshot* /*aSnapshot*/ /*nullptr*/) {
 	totalWrites++;
+	MetricTimer timer(Metrics::dbPutTime);
 	leveldb::Slice key((const char*)aKey, keyLen);
 	leveldb::Slice value((const char*)aValue, valueLen);
 
@@ -138,7 +140,11 @@ bool LevelDB::get(void* aKey, size_t keyLen, size_t /*initialValueLen*/, std::fu
 	totalReads++;
 	string value;
 	leveldb::Slice key((const char*)aKey, keyLen);
-	auto ret = DBACTION(db->Get(readoptions, key, &value));
+	leveldb::Status ret;
+	{
+		MetricTimer timer(Metrics::dbGetTime);
+		ret = DBACTION(db->Get(readoptions, key, &value));
+	}
 	if (ret.ok()) {
 		return loadF((void*)value.data(), value.size());
 	}
@@ -0,0 +1,231 @@
+/*
+ * Copyright (C) 2012-2019 AirDC++ Project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include "stdinc.h"
+
+#ifdef LOCK_PROFILING
+
+#include "LockProfiler.h"
+
+#include "File.h"
+#include "Util.h"
+
+#include <chrono>
+
+namespace dcpp {
+
+// Waits longer than this are counted as contended acquisitions
+#define CONTENDED_NANOS 1000
+
+LockProfiler::Site LockProfiler::overflowSite;
+LockProfiler::Site LockProfiler::sites[MAX_SITES];
+
+void LockProfiler::Histogram::add(uint64_t aNanos) noexcept {
+	int bucket = 0;
+	for (auto n = aNanos >> 1; n > 0 && bucket < HISTOGRAM_BUCKETS - 1; n >>= 1) {
+		bucket++;
+	}
+
+	buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+	total.fetch_add(aNanos, std::memory_order_relaxed);
+
+	auto curMax = max.load(std::memory_order_relaxed);
+	while (aNanos > curMax && !max.compare_exchange_weak(curMax, aNanos, std::memory_order_relaxed)) {
+		// retry
+	}
+}
+
+uint64_t LockProfiler::Histogram::getPercentile(double aPercentile) const noexcept {
+	uint64_t count = 0;
+	for (const auto& b: buckets) {
+		count += b.load(std::memory_order_relaxed);
+	}
+
+	auto target = static_cast<uint64_t>(count * aPercentile);
+	uint64_t cur = 0;
+	for (int i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+		cur += buckets[i].load(std::memory_order_relaxed);
+		if (cur > target) {
+			return 1ULL << (i + 1);
+		}
+	}
+
+	return max.load(std::memory_order_relaxed);
+}
+
+uint64_t LockProfiler::getTime() noexcept {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+LockProfiler::Site* LockProfiler::getSite(const char* aFile, int aLine) noexcept {
+	// The same location may get multiple sites if the file name isn't pooled by the compiler (they are merged in the dump)
+	auto key = (static_cast<uint64_t>(aLine) << 48) ^ static_cast<uint64_t>(reinterpret_cast<uintptr_t>(aFile));
+	auto pos = static_cast<size_t>((key * 0x9E3779B97F4A7C15ULL) >> 52) % MAX_SITES;
+
+	for (int i = 0; i < MAX_SITES; ++i) {
+		auto& site = sites[(pos + i) % MAX_SITES];
+
+		auto cur = site.key.load(std::memory_order_acquire);
+		if (cur == key) {
+			return &site;
+		}
+
+		if (cur == 0) {
+			if (site.key.compare_exchange_strong(cur, key, std::memory_order_acq_rel)) {
+				site.line.store(aLine, std::memory_order_relaxed);
+				site.file.store(aFile, std::memory_order_release);
+				return &site;
+			}
+
+			if (cur == key) {
+				return &site;
+			}
+		}
+	}
+
+	return &overflowSite;
+}
+
+void LockSiteTimer::onAcquired() noexcept {
+	acquired = LockProfiler::getTime();
+
+	auto wait = acquired - start;
+	site->acquisitions.fetch_add(1, std::memory_order_relaxed);
+	if (wait >= CONTENDED_NANOS) {
+		site->contended.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	site->wait.add(wait);
+}
+
+void LockSiteTimer::onReleased() noexcept {
+	site->hold.add(LockProfiler::getTime() - acquired);
+}
+
+namespace {
+
+struct SiteStats {
+	string name;
+	const LockProfiler::Site* site = nullptr;
+	uint64_t acquisitions = 0;
+	uint64_t contended = 0;
+	uint64_t waitTotal = 0;
+	uint64_t holdTotal = 0;
+};
+
+string formatNanos(uint64_t aNanos) noexcept {
+	if (aNanos >= 1000000) {
+		return Util::toString(aNanos / 1000000) + " ms";
+	}
+
+	return Util::toString(aNanos / 1000) + " us";
+}
+
+}
+
+string LockProfiler::dump(size_t aMaxSites) noexcept {
+	unordered_map<string, SiteStats> stats;
+
+	auto addSite = [&](const Site& aSite, const string& aName) {
+		auto& s = stats[aName];
+		s.name = aName;
+		if (!s.site || s.site->acquisitions < aSite.acquisitions) {
+			// Percentiles are shown for the busiest copy
+			s.site = &aSite;
+		}
+
+		s.acquisitions += aSite.acquisitions;
+		s.contended += aSite.contended;
+		s.waitTotal += aSite.wait.total;
+		s.holdTotal += aSite.hold.total;
+	};
+
+	for (const auto& site: sites) {
+		auto file = site.file.load(std::memory_order_acquire);
+		if (file && site.acquisitions > 0) {
+			addSite(site, Util::getFileName(file) + ":" + Util::toString(site.line.load()));
+		}
+	}
+
+	if (overflowSite.acquisitions > 0) {
+		addSite(overflowSite, "(other sites)");
+	}
+
+	vector<SiteStats> sorted;
+	for (auto& s: stats) {
+		sorted.push_back(move(s.second));
+	}
+
+	sort(sorted.begin(), sorted.end(), [](const SiteStats& a, const SiteStats& b) { return a.waitTotal > b.waitTotal; });
+	if (sorted.size() > aMaxSites) {
+		sorted.resize(aMaxSites);
+	}
+
+	string ret = "\r\n\r\n-=[ Lock statistics (sorted by total wait time) ]=-\r\n\r\n";
+	for (const auto& s: sorted) {
+		ret += boost::str(boost::format(
+"%s\r\n\
+	Acquisitions: %d (%d%% contended)\r\n\
+	Wait: total %s, avg %s, p99 < %s, max %s\r\n\
+	Hold: total %s, avg %s, p99 < %s, max %s\r\n")
+
+			% s.name
+			% s.acquisitions % Util::countPercentage(s.contended, s.acquisitions)
+			% formatNanos(s.waitTotal) % formatNanos(Util::countAverageInt64(s.waitTotal, s.acquisitions))
+			% formatNanos(s.site->wait.getPercentile(0.99)) % formatNanos(s.site->wait.max)
+			% formatNanos(s.holdTotal) % formatNanos(Util::countAverageInt64(s.holdTotal, s.acquisitions))
+			% formatNanos(s.site->hold.getPercentile(0.99)) % formatNanos(s.site->hold.max)
+		);
+	}
+
+	return ret;
+}
+
+void LockProfiler::dumpToFile(const string& aPath) noexcept {
+	try {
+		File f(aPath, File::WRITE, File::CREATE | File::TRUNCATE);
+		f.write(dump(MAX_SITES));
+	} catch (const FileException& e) {
+		dcdebug("LockProfiler: failed to write %s (%s)\n", aPath.c_str(), e.getError().c_str());
+	}
+}
+
+void LockProfiler::reset() noexcept {
+	auto resetSite = [](Site& aSite) {
+		aSite.acquisitions = 0;
+		aSite.contended = 0;
+		for (auto h: { &aSite.wait, &aSite.hold }) {
+			for (auto& b: h->buckets) {
+				b = 0;
+			}
+
+			h->total = 0;
+			h->max = 0;
+		}
+	};
+
+	for (auto& site: sites) {
+		resetSite(site);
+	}
+
+	resetSite(overflowSite);
+}
+
+}
+
+#endif
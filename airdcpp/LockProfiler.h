@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2012-2019 AirDC++ Project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef DCPLUSPLUS_DCPP_LOCKPROFILER_H_
+#define DCPLUSPLUS_DCPP_LOCKPROFILER_H_
+
+// Lock contention profiling is enabled by building with LOCK_PROFILING
+// The lock guards in CriticalSection.h are the plain standard/boost types otherwise
+#ifdef LOCK_PROFILING
+
+#include <atomic>
+#include <string>
+#include <stdint.h>
+
+namespace dcpp {
+
+// Collects wait and hold times for each lock site (source location where the lock guard is constructed)
+// Sites are stored in a fixed-size table that is updated without locking
+class LockProfiler {
+public:
+	// Bucket N contains durations of [2^N, 2^(N+1)) nanoseconds
+	static const int HISTOGRAM_BUCKETS = 32;
+
+	struct Histogram {
+		void add(uint64_t aNanos) noexcept;
+
+		// Upper bound of the bucket containing the percentile
+		uint64_t getPercentile(double aPercentile) const noexcept;
+
+		std::atomic<uint64_t> buckets[HISTOGRAM_BUCKETS];
+		std::atomic<uint64_t> total;
+		std::atomic<uint64_t> max;
+	};
+
+	struct Site {
+		std::atomic<uint64_t> key;
+		std::atomic<const char*> file;
+		std::atomic<int> line;
+
+		std::atomic<uint64_t> acquisitions;
+		std::atomic<uint64_t> contended;
+
+		Histogram wait;
+		Histogram hold;
+	};
+
+	static Site* getSite(const char* aFile, int aLine) noexcept;
+	static uint64_t getTime() noexcept;
+
+	// Sites sorted by the total wait time
+	static std::string dump(size_t aMaxSites = 50) noexcept;
+	static void dumpToFile(const std::string& aPath) noexcept;
+
+	static void reset() noexcept;
+private:
+	static const int MAX_SITES = 4096;
+
+	// Sites that didn't fit in the table
+	static Site overflowSite;
+	static Site sites[MAX_SITES];
+};
+
+class LockSiteTimer {
+protected:
+	LockSiteTimer(const char* aFile, int aLine) noexcept : site(LockProfiler::getSite(aFile, aLine)), start(LockProfiler::getTime()) { }
+
+	void onAcquired() noexcept;
+	void onReleased() noexcept;
+private:
+	LockProfiler::Site* site;
+	uint64_t start;
+	uint64_t acquired = 0;
+};
+
+// Lock guard that reports the times to the site where it's constructed
+template<class LockT>
+class ProfiledLock : private LockSiteTimer, public LockT {
+public:
+	template<class MutexT>
+	ProfiledLock(MutexT& aMutex, const char* aFile = __builtin_FILE(), int aLine = __builtin_LINE()) noexcept : LockSiteTimer(aFile, aLine), LockT(aMutex) {
+		onAcquired();
+	}
+
+	~ProfiledLock() noexcept {
+		onReleased();
+	}
+
+	ProfiledLock(const ProfiledLock&) = delete;
+	ProfiledLock& operator=(const ProfiledLock&) = delete;
+};
+
+}
+
+#endif
+
+#endif /* DCPLUSPLUS_DCPP_LOCKPROFILER_H_ */
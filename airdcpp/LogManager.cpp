@@ -26,7 +26,10 @@
 
 namespace dcpp {
 
-LogManager::LogManager() : tasks(true, Thread::IDLE), cache(SettingsManager::LOG_MESSAGE_CACHE) {
+LogManager::LogManager() : cache(SettingsManager::LOG_MESSAGE_CACHE), writer([this](const string& aPath, const string& aError) {
+	// Just don't try to write the error into a file...
+	message(STRING_F(WRITE_FAILED_X, aPath % aError), LogMessage::SEV_NOTIFY);
+}) {
 
 	options[UPLOAD][FILE] = SettingsManager::LOG_FILE_UPLOAD;
 	options[UPLOAD][FORMAT] = SettingsManager::LOG_FORMAT_POST_UPLOAD;
@@ -159,6 +162,11 @@ string LogManager::readFromEnd(const string& aPath, int aMaxLines, int64_t aBuff
 		return Util::emptyString;
 	}
 
+	if (LogManager::getInstance()) {
+		// The file may have lines that haven't been written yet
+		LogManager::getInstance()->flushLogs();
+	}
+
 	string ret;
 	try {
 		File f(aPath, File::READ, File::OPEN);
@@ -186,18 +194,7 @@ string LogManager::readFromEnd(const string& aPath, int aMaxLines, int64_t aBuff
 }
 
 void LogManager::log(const string& area, const string& msg) noexcept {
-	tasks.addTask([=] {
-		auto aArea = Util::validatePath(area);
-		try {
-			File::ensureDirectory(aArea);
-			File f(aArea, File::WRITE, File::OPEN | File::CREATE);
-			f.setEndPos(0);
-			f.write(msg + "\r\n");
-		} catch (const FileException& e) {
-			// Just don't try to write the error into a file...
-			message(STRING_F(WRITE_FAILED_X, aArea % e.what()), LogMessage::SEV_NOTIFY);
-		}
-	});
+	writer.addLine(Util::validatePath(area), msg);
 }
 
 } // namespace dcpp
@@ -25,8 +25,8 @@
 #include "typedefs.h"
 
 #include "CID.h"
-#include "DispatcherQueue.h"
 #include "LogManagerListener.h"
+#include "LogWriter.h"
 #include "Message.h"
 #include "MessageCache.h"
 #include "Singleton.h"
@@ -61,6 +61,16 @@ public:
 	void clearCache() noexcept;
 	void setRead() noexcept;
 
+	// Bytes of log lines waiting to be written to disk
+	size_t getLogBacklog() const noexcept {
+		return writer.getBacklog();
+	}
+
+	// Write pending lines to disk
+	void flushLogs() noexcept {
+		writer.flush();
+	}
+
 	static string readFromEnd(const string& aPath, int aMaxLines, int64_t aBufferSize) noexcept;
 private:
 	MessageCache cache;
@@ -77,7 +87,7 @@ private:
 	unordered_map<CID, string> pmPaths;
 	static void ensureParam(const string& aParam, string& aFile) noexcept;
 
-	DispatcherQueue tasks;
+	LogWriter writer;
 };
 
 #define LOG(area, msg) LogManager::getInstance()->log(area, msg)
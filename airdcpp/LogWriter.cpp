@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) 2012-2019 AirDC++ Project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include "stdinc.h"
+
+#include "LogWriter.h"
+#include "TimerManager.h"
+
+namespace dcpp {
+
+// Maximum time that lines are kept in memory before writing them
+#define FLUSH_INTERVAL 1000
+
+// Write immediately when there is this much pending data
+#define MAX_BACKLOG_BYTES 64*1024
+
+#define MAX_OPEN_FILES 16
+
+// Files that haven't been written in this time are closed so that they can be moved/deleted
+#define IDLE_FILE_TIMEOUT 60*1000
+
+LogWriter::LogWriter(ErrorF&& aErrorF) noexcept : errorF(move(aErrorF)) {
+	start();
+}
+
+LogWriter::~LogWriter() {
+	stop = true;
+	s.signal();
+	join();
+
+	// The thread flushed everything before exiting
+	Lock l(fileCS);
+	openFiles.clear();
+}
+
+int LogWriter::run() {
+	setThreadPriority(Thread::IDLE);
+
+	while (!stop) {
+		s.wait(FLUSH_INTERVAL);
+
+		flush();
+		closeIdleFiles(GET_TICK());
+	}
+
+	flush();
+	return 0;
+}
+
+void LogWriter::addLine(const string& aPath, const string& aLine) noexcept {
+	auto len = aLine.size() + 2;
+
+	bool full;
+
+	{
+		Lock l(cs);
+		auto& data = pendingLines[aPath];
+		data.reserve(data.size() + len);
+		data += aLine;
+		data += "\r\n";
+
+		// Must be updated together with the lines so that a concurrent flush won't leave it out of sync
+		full = (backlog += len) >= MAX_BACKLOG_BYTES;
+	}
+
+	if (full) {
+		s.signal();
+	}
+}
+
+void LogWriter::flush() noexcept {
+	decltype(pendingLines) lines;
+
+	// Hold the file lock while taking the lines, otherwise a concurrent flush could write a later batch first
+	Lock fl(fileCS);
+
+	{
+		Lock l(cs);
+		if (pendingLines.empty()) {
+			return;
+		}
+
+		lines.swap(pendingLines);
+		backlog = 0;
+	}
+
+	auto tick = GET_TICK();
+	for (const auto& p: lines) {
+		try {
+			getFile(p.first, tick).write(p.second);
+		} catch (const FileException& e) {
+			// Reopen on the next write
+			openFiles.remove_if([&](const OpenFile& f) { return f.path == p.first; });
+			errorF(p.first, e.getError());
+		}
+	}
+}
+
+File& LogWriter::getFile(const string& aPath, uint64_t aTick) {
+	auto i = find_if(openFiles.begin(), openFiles.end(), [&](const OpenFile& f) { return f.path == aPath; });
+	if (i != openFiles.end()) {
+		openFiles.splice(openFiles.begin(), openFiles, i);
+	} else {
+		File::ensureDirectory(aPath);
+
+		auto f = make_unique<File>(aPath, File::WRITE, File::OPEN | File::CREATE | File::SHARED_WRITE | File::SHARED_DELETE);
+		f->setEndPos(0);
+		openFiles.push_front({ aPath, move(f), aTick });
+
+		if (openFiles.size() > MAX_OPEN_FILES) {
+			openFiles.pop_back();
+		}
+	}
+
+	openFiles.front().lastUsed = aTick;
+	return *openFiles.front().file;
+}
+
+void LogWriter::closeIdleFiles(uint64_t aTick) noexcept {
+	Lock l(fileCS);
+	while (!openFiles.empty() && openFiles.back().lastUsed + IDLE_FILE_TIMEOUT < aTick) {
+		openFiles.pop_back();
+	}
+}
+
+size_t LogWriter::getOpenFileCount() const noexcept {
+	Lock l(fileCS);
+	return openFiles.size();
+}
+
+}
@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2012-2019 AirDC++ Project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef DCPLUSPLUS_DCPP_LOGWRITER_H_
+#define DCPLUSPLUS_DCPP_LOGWRITER_H_
+
+#include "CriticalSection.h"
+#include "File.h"
+#include "Semaphore.h"
+#include "Thread.h"
+#include "typedefs.h"
+
+namespace dcpp {
+
+// Appends lines to log files from a background thread
+// Lines are batched per file and written when the flush interval expires or when
+// enough data is pending; the most recently used files are kept open between writes
+class LogWriter : private Thread {
+public:
+	typedef std::function<void (const string& /*aPath*/, const string& /*aError*/)> ErrorF;
+
+	LogWriter(ErrorF&& aErrorF) noexcept;
+
+	// Writes all pending lines before returning
+	~LogWriter();
+
+	// The path must have been validated by the caller
+	void addLine(const string& aPath, const string& aLine) noexcept;
+
+	// Write pending lines synchronously
+	void flush() noexcept;
+
+	// Bytes that haven't been passed to the files yet
+	size_t getBacklog() const noexcept { return backlog; }
+	size_t getOpenFileCount() const noexcept;
+private:
+	int run() override;
+
+	struct OpenFile {
+		string path;
+		unique_ptr<File> file;
+		uint64_t lastUsed;
+	};
+
+	// Most recently used files are at the front
+	typedef list<OpenFile> FileList;
+
+	// Throws FileException
+	File& getFile(const string& aPath, uint64_t aTick);
+	void closeIdleFiles(uint64_t aTick) noexcept;
+
+	// Pending data by file path
+	unordered_map<string, string> pendingLines;
+	atomic<size_t> backlog { 0 };
+	CriticalSection cs;
+
+	FileList openFiles;
+	mutable CriticalSection fileCS;
+
+	Semaphore s;
+	atomic<bool> stop { false };
+	const ErrorF errorF;
+};
+
+}
+
+#endif /* DCPLUSPLUS_DCPP_LOGWRITER_H_ */
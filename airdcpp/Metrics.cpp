@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) 2012-2019 AirDC++ Project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include "stdinc.h"
+
+#include "Metrics.h"
+
+#include "File.h"
+#include "Util.h"
+
+namespace dcpp {
+
+#define MICROSECONDS 1000000.0
+#define BYTES 1.0
+
+MetricCounter Metrics::incomingSearches("airdcpp_search_incoming_total", "Incoming ADC searches that were matched against the share");
+MetricCounter Metrics::searchResultsSent("airdcpp_search_results_sent_total", "Search results sent to other users");
+MetricHistogram Metrics::searchTime("airdcpp_search_duration_seconds", "Time spent on matching an incoming ADC search against the share", MICROSECONDS);
+MetricHistogram Metrics::searchResponseTime("airdcpp_search_response_seconds", "Time from receiving an ADC search to sending the results (SCH -> RES)", MICROSECONDS);
+
+MetricCounter Metrics::hashedBytes("airdcpp_hash_bytes_total", "Bytes read by the hashers");
+MetricCounter Metrics::hashedFiles("airdcpp_hash_files_total", "Files hashed successfully");
+MetricHistogram Metrics::hashSpeed("airdcpp_hash_file_speed_bytes", "Average hashing speed of a file (bytes per second)", BYTES);
+
+MetricHistogram Metrics::dbGetTime("airdcpp_db_get_seconds", "Duration of database reads", MICROSECONDS);
+MetricHistogram Metrics::dbPutTime("airdcpp_db_put_seconds", "Duration of database writes", MICROSECONDS);
+
+MetricHistogram Metrics::startDownloadTime("airdcpp_queue_start_download_seconds", "Time spent on picking the next queued download for a user", MICROSECONDS);
+
+MetricCounter Metrics::socketBytesDown("airdcpp_socket_received_bytes_total", "Bytes received from all sockets");
+MetricCounter Metrics::socketBytesUp("airdcpp_socket_sent_bytes_total", "Bytes sent to all sockets");
+
+int MetricCounter::getShard() noexcept {
+	static std::atomic<int> nextShard { 0 };
+	static thread_local int shard = nextShard++ % SHARDS;
+	return shard;
+}
+
+uint64_t MetricCounter::get() const noexcept {
+	uint64_t ret = 0;
+	for (const auto& s: shards) {
+		ret += s.value.load(std::memory_order_relaxed);
+	}
+
+	return ret;
+}
+
+int MetricHistogram::getBucket(uint64_t aValue) noexcept {
+	if (aValue < SUB_BUCKETS) {
+		return static_cast<int>(aValue);
+	}
+
+	// Index of the highest set bit
+	int msb = 0;
+	for (auto v = aValue >> 1; v > 0; v >>= 1) {
+		msb++;
+	}
+
+	auto shift = msb - SUB_BUCKET_BITS;
+	return (shift + 1) * SUB_BUCKETS + static_cast<int>((aValue >> shift) & (SUB_BUCKETS - 1));
+}
+
+uint64_t MetricHistogram::getBucketMiddle(int aBucket) noexcept {
+	if (aBucket < SUB_BUCKETS) {
+		return aBucket;
+	}
+
+	auto shift = aBucket / SUB_BUCKETS - 1;
+	auto lowerBound = static_cast<uint64_t>(SUB_BUCKETS + aBucket % SUB_BUCKETS) << shift;
+	return lowerBound + ((1ULL << shift) >> 1);
+}
+
+void MetricHistogram::record(uint64_t aValue) noexcept {
+	buckets[getBucket(aValue)].fetch_add(1, std::memory_order_relaxed);
+	count.fetch_add(1, std::memory_order_relaxed);
+	sum.fetch_add(aValue, std::memory_order_relaxed);
+}
+
+uint64_t MetricHistogram::getPercentile(double aPercentile) const noexcept {
+	uint64_t total = 0;
+	for (const auto& b: buckets) {
+		total += b.load(std::memory_order_relaxed);
+	}
+
+	if (total == 0) {
+		return 0;
+	}
+
+	auto target = static_cast<uint64_t>(static_cast<double>(total - 1) * aPercentile);
+	uint64_t cur = 0;
+	for (int i = 0; i < BUCKETS; ++i) {
+		cur += buckets[i].load(std::memory_order_relaxed);
+		if (cur > target) {
+			return getBucketMiddle(i);
+		}
+	}
+
+	return getBucketMiddle(BUCKETS - 1);
+}
+
+namespace {
+
+string formatHeader(const char* aName, const char* aHelp, const char* aType) noexcept {
+	return string("# HELP ") + aName + " " + aHelp + "\n# TYPE " + aName + " " + aType + "\n";
+}
+
+string formatCounter(const MetricCounter& aCounter) noexcept {
+	return formatHeader(aCounter.name, aCounter.help, "counter") + aCounter.name + " " + Util::toString(aCounter.get()) + "\n";
+}
+
+string formatHistogram(const MetricHistogram& aHistogram) noexcept {
+	auto ret = formatHeader(aHistogram.name, aHistogram.help, "summary");
+	for (auto q: { 0.5, 0.9, 0.99, 0.999 }) {
+		ret += boost::str(boost::format("%s{quantile=\"%g\"} %g\n") % aHistogram.name % q % (aHistogram.getPercentile(q) / aHistogram.unit));
+	}
+
+	ret += boost::str(boost::format("%s_sum %g\n") % aHistogram.name % (aHistogram.getSum() / aHistogram.unit));
+	ret += string(aHistogram.name) + "_count " + Util::toString(aHistogram.getCount()) + "\n";
+	return ret;
+}
+
+}
+
+string Metrics::getSnapshot() noexcept {
+	string ret;
+	for (auto c: { &incomingSearches, &searchResultsSent, &hashedBytes, &hashedFiles, &socketBytesDown, &socketBytesUp }) {
+		ret += formatCounter(*c);
+	}
+
+	for (auto h: { &searchTime, &searchResponseTime, &hashSpeed, &dbGetTime, &dbPutTime, &startDownloadTime }) {
+		ret += formatHistogram(*h);
+	}
+
+	return ret;
+}
+
+void Metrics::saveSnapshot(const string& aPath) noexcept {
+	try {
+		{
+			File f(aPath + ".tmp", File::WRITE, File::CREATE | File::TRUNCATE);
+			f.write(getSnapshot());
+		}
+
+		File::renameFile(aPath + ".tmp", aPath);
+	} catch (const FileException& e) {
+		dcdebug("Metrics: failed to save the snapshot to %s (%s)\n", aPath.c_str(), e.getError().c_str());
+	}
+}
+
+}
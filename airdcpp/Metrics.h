@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) 2012-2019 AirDC++ Project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef DCPLUSPLUS_DCPP_METRICS_H_
+#define DCPLUSPLUS_DCPP_METRICS_H_
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <stdint.h>
+
+namespace dcpp {
+
+using std::string;
+
+// Counter that is split between threads so that frequent updates don't fight over the same cache line
+class MetricCounter {
+public:
+	constexpr MetricCounter(const char* aName, const char* aHelp) noexcept : name(aName), help(aHelp) { }
+
+	void add(uint64_t aValue = 1) noexcept {
+		shards[getShard()].value.fetch_add(aValue, std::memory_order_relaxed);
+	}
+
+	uint64_t get() const noexcept;
+
+	const char* const name;
+	const char* const help;
+private:
+	static const int SHARDS = 16;
+
+	struct alignas(64) Shard {
+		std::atomic<uint64_t> value { 0 };
+	};
+
+	Shard shards[SHARDS];
+
+	static int getShard() noexcept;
+};
+
+// Log-linear (HDR style) histogram
+// Each power of two range is split into SUB_BUCKETS linear buckets, which keeps the relative error under 12.5%
+class MetricHistogram {
+public:
+	// Recorded values are divided by aUnit in snapshots (e.g. microseconds -> seconds)
+	constexpr MetricHistogram(const char* aName, const char* aHelp, double aUnit) noexcept : name(aName), help(aHelp), unit(aUnit) { }
+
+	void record(uint64_t aValue) noexcept;
+
+	// Approximate value (middle of the bucket) below which the given fraction of recorded values fall
+	uint64_t getPercentile(double aPercentile) const noexcept;
+
+	uint64_t getCount() const noexcept { return count; }
+	uint64_t getSum() const noexcept { return sum; }
+
+	const char* const name;
+	const char* const help;
+	const double unit;
+private:
+	static const int SUB_BUCKET_BITS = 3;
+	static const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+	static const int BUCKETS = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+	static int getBucket(uint64_t aValue) noexcept;
+	static uint64_t getBucketMiddle(int aBucket) noexcept;
+
+	std::atomic<uint64_t> buckets[BUCKETS] = {};
+	std::atomic<uint64_t> count { 0 };
+	std::atomic<uint64_t> sum { 0 };
+};
+
+// Records the lifetime of the object in microseconds
+class MetricTimer {
+public:
+	explicit MetricTimer(MetricHistogram& aHistogram) noexcept : histogram(aHistogram), start(std::chrono::steady_clock::now()) { }
+	~MetricTimer() noexcept {
+		histogram.record(getElapsed());
+	}
+
+	uint64_t getElapsed() const noexcept {
+		return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	MetricTimer(const MetricTimer&) = delete;
+	MetricTimer& operator=(const MetricTimer&) = delete;
+private:
+	MetricHistogram& histogram;
+	const std::chrono::steady_clock::time_point start;
+};
+
+// Metrics for hot paths
+// The objects are constant-initialized so they can be used at any stage of the startup/shutdown
+class Metrics {
+public:
+	// Search handling
+	static MetricCounter incomingSearches;
+	static MetricCounter searchResultsSent;
+	static MetricHistogram searchTime;
+	static MetricHistogram searchResponseTime;
+
+	// Hashing
+	static MetricCounter hashedBytes;
+	static MetricCounter hashedFiles;
+	static MetricHistogram hashSpeed;
+
+	// Database
+	static MetricHistogram dbGetTime;
+	static MetricHistogram dbPutTime;
+
+	// Queue
+	static MetricHistogram startDownloadTime;
+
+	// Sockets
+	static MetricCounter socketBytesDown;
+	static MetricCounter socketBytesUp;
+
+	// Text snapshot of all metrics in the Prometheus exposition format
+	static string getSnapshot() noexcept;
+
+	// Write the snapshot in a file (e.g. for the node exporter textfile collector)
+	// The file is replaced atomically
+	static void saveSnapshot(const string& aPath) noexcept;
+};
+
+}
+
+#endif /* DCPLUSPLUS_DCPP_METRICS_H_ */
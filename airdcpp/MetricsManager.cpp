@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2012-2019 AirDC++ Project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include "stdinc.h"
+
+#include "MetricsManager.h"
+
+#include "Metrics.h"
+#include "SettingsManager.h"
+#include "TimerManager.h"
+#include "Util.h"
+
+namespace dcpp {
+
+MetricsManager::MetricsManager() {
+	TimerManager::getInstance()->addListener(this);
+}
+
+MetricsManager::~MetricsManager() {
+	TimerManager::getInstance()->removeListener(this);
+
+	// Leave the final values for the collector
+	if (SETTING(METRICS_SNAPSHOT_INTERVAL) > 0) {
+		Metrics::saveSnapshot(getSnapshotPath());
+	}
+}
+
+string MetricsManager::getSnapshotPath() noexcept {
+	return Util::getPath(Util::PATH_USER_LOCAL) + "Metrics.prom";
+}
+
+void MetricsManager::on(TimerManagerListener::Second, uint64_t aTick) noexcept {
+	auto interval = SETTING(METRICS_SNAPSHOT_INTERVAL);
+	if (interval <= 0 || lastSave + interval * 1000ULL > aTick) {
+		return;
+	}
+
+	lastSave = aTick;
+	Metrics::saveSnapshot(getSnapshotPath());
+}
+
+} // namespace dcpp
@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2012-2019 AirDC++ Project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef DCPLUSPLUS_DCPP_METRICS_MANAGER_H_
+#define DCPLUSPLUS_DCPP_METRICS_MANAGER_H_
+
+#include "typedefs.h"
+
+#include "Singleton.h"
+#include "TimerManagerListener.h"
+
+namespace dcpp {
+
+// Writes the metric snapshot periodically for local collectors (interval set with METRICS_SNAPSHOT_INTERVAL)
+class MetricsManager : public Singleton<MetricsManager>, private TimerManagerListener {
+public:
+	MetricsManager();
+	~MetricsManager();
+
+	// Location of the snapshot file
+	static string getSnapshotPath() noexcept;
+private:
+	friend class Singleton<MetricsManager>;
+
+	void on(TimerManagerListener::Second, uint64_t aTick) noexcept override;
+
+	uint64_t lastSave = 0;
+};
+
+} // namespace dcpp
+
+#endif // DCPLUSPLUS_DCPP_METRICS_MANAGER_H_
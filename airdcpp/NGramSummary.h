@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2012-2019 AirDC++ Project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef DCPLUSPLUS_DCPP_NGRAM_SUMMARY_H
+#define DCPLUSPLUS_DCPP_NGRAM_SUMMARY_H
+
+#include "typedefs.h"
+
+#include <array>
+
+namespace dcpp {
+
+// Fixed-size set of character trigrams present in a collection of strings
+// The set may contain false positives (hash collisions, removed strings) but never false negatives,
+// so it can be used to tell that none of the strings contains a substring
+class NGramSummary {
+public:
+	static const size_t N = 3;
+
+	NGramSummary() noexcept { }
+	explicit NGramSummary(const string& aStr) noexcept { add(aStr); }
+
+	void add(const string& aStr) noexcept {
+		if (aStr.length() < N) {
+			return;
+		}
+
+		auto p = reinterpret_cast<const uint8_t*>(aStr.data());
+		for (size_t i = 0; i <= aStr.length() - N; ++i) {
+			set(getPos(p + i));
+		}
+	}
+
+	void merge(const NGramSummary& aOther) noexcept {
+		for (size_t i = 0; i < WORDS; ++i) {
+			bits[i] |= aOther.bits[i];
+		}
+	}
+
+	// Returns false if the substring (that was used to create the other summary) can't be found from any added string
+	// Substrings shorter than N will always match
+	bool mayContain(const NGramSummary& aSubstring) const noexcept {
+		for (size_t i = 0; i < WORDS; ++i) {
+			if ((bits[i] & aSubstring.bits[i]) != aSubstring.bits[i]) {
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	void clear() noexcept {
+		bits.fill(0);
+	}
+private:
+	static const size_t WORDS = 4;
+	static const size_t BITS = WORDS * 64;
+
+	static_assert(BITS == 256, "getPos must return 8 bits");
+
+	static size_t getPos(const uint8_t* aGram) noexcept {
+		uint32_t h = (aGram[0] << 16) | (aGram[1] << 8) | aGram[2];
+		h *= 0x9e3779b1;
+		return h >> 24;
+	}
+
+	void set(size_t aPos) noexcept {
+		bits[aPos / 64] |= 1ULL << (aPos % 64);
+	}
+
+	std::array<uint64_t, WORDS> bits { { 0, 0, 0, 0 } };
+};
+
+}
+
+#endif // !defined(DCPLUSPLUS_DCPP_NGRAM_SUMMARY_H)
@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2012-2019 AirDC++ Project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include "stdinc.h"
+
+#include "AirUtil.h"
+#include "PartialListCache.h"
+#include "Text.h"
+
+namespace dcpp {
+
+PartialListCache::Key::Key(const OptionalProfileToken& aProfile, const string& aVirtualPath, bool aRecursive) noexcept :
+	profile(aProfile), pathLower(Text::toLower(aVirtualPath)), recursive(aRecursive) {
+
+}
+
+bool PartialListCache::Key::operator==(const Key& aOther) const noexcept {
+	return recursive == aOther.recursive && profile == aOther.profile && pathLower == aOther.pathLower;
+}
+
+size_t PartialListCache::KeyHash::operator()(const Key& aKey) const noexcept {
+	size_t ret = std::hash<string>()(aKey.pathLower);
+	ret ^= std::hash<int>()(aKey.profile ? *aKey.profile : -1) + 0x9e3779b9 + (ret << 6) + (ret >> 2);
+	return aKey.recursive ? ~ret : ret;
+}
+
+PartialListCache::PartialListCache(size_t aMaxBytes, size_t aMaxEntries) noexcept : maxBytes(aMaxBytes), maxEntries(aMaxEntries) {
+
+}
+
+SharedBuffer PartialListCache::get(const Key& aKey) noexcept {
+	Lock l(cs);
+	auto i = index.find(aKey);
+	if (i == index.end()) {
+		misses++;
+		return SharedBuffer();
+	}
+
+	// Move to front
+	entries.splice(entries.begin(), entries, i->second);
+
+	hits++;
+	return i->second->second;
+}
+
+void PartialListCache::put(const Key& aKey, const SharedBuffer& aList, uint64_t aGeneration) noexcept {
+	if (aList.empty() || aList.getSize() > maxBytes / 4) {
+		// Don't let a single huge list flush everything else
+		return;
+	}
+
+	Lock l(cs);
+	if (aGeneration != generation) {
+		return;
+	}
+
+	{
+		auto i = index.find(aKey);
+		if (i != index.end()) {
+			removeEntry(i->second);
+		}
+	}
+
+	entries.emplace_front(aKey, aList);
+	index.emplace(aKey, entries.begin());
+	totalBytes += aList.getSize();
+
+	while (!entries.empty() && (totalBytes > maxBytes || entries.size() > maxEntries)) {
+		removeEntry(prev(entries.end()));
+	}
+}
+
+void PartialListCache::removeEntry(EntryList::iterator aEntry) noexcept {
+	totalBytes -= aEntry->second.getSize();
+	index.erase(aEntry->first);
+	entries.erase(aEntry);
+}
+
+void PartialListCache::invalidate(const string& aVirtualPath) noexcept {
+	Lock l(cs);
+	generation++;
+
+	for (auto i = entries.begin(); i != entries.end();) {
+		auto cur = i++;
+		if (AirUtil::isParentOrExactAdc(cur->first.pathLower, aVirtualPath)) {
+			removeEntry(cur);
+		}
+	}
+}
+
+void PartialListCache::clear() noexcept {
+	Lock l(cs);
+	generation++;
+
+	index.clear();
+	entries.clear();
+	totalBytes = 0;
+}
+
+size_t PartialListCache::getEntryCount() const noexcept {
+	Lock l(cs);
+	return entries.size();
+}
+
+size_t PartialListCache::getTotalBytes() const noexcept {
+	Lock l(cs);
+	return totalBytes;
+}
+
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2012-2019 AirDC++ Project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef DCPLUSPLUS_DCPP_PARTIALLISTCACHE_H_
+#define DCPLUSPLUS_DCPP_PARTIALLISTCACHE_H_
+
+#include "CriticalSection.h"
+#include "Streams.h"
+#include "typedefs.h"
+
+namespace dcpp {
+
+// Bounded LRU cache for generated partial file lists
+// Entries are keyed by (profile, virtual path, recursive) and must be invalidated
+// by the caller whenever the share content under the path changes
+class PartialListCache {
+public:
+	struct Key {
+		Key(const OptionalProfileToken& aProfile, const string& aVirtualPath, bool aRecursive) noexcept;
+
+		bool operator==(const Key& aOther) const noexcept;
+
+		const OptionalProfileToken profile;
+		const string pathLower;
+		const bool recursive;
+	};
+
+	struct KeyHash {
+		size_t operator()(const Key& aKey) const noexcept;
+	};
+
+	PartialListCache(size_t aMaxBytes, size_t aMaxEntries) noexcept;
+
+	// Returns an empty buffer if the list isn't cached
+	SharedBuffer get(const Key& aKey) noexcept;
+
+	// The list is stored only if the cache hasn't been invalidated after the generation
+	// was fetched (the content is possibly stale otherwise)
+	void put(const Key& aKey, const SharedBuffer& aList, uint64_t aGeneration) noexcept;
+
+	// Remove lists for the virtual path and all its parents
+	void invalidate(const string& aVirtualPath) noexcept;
+	void clear() noexcept;
+
+	// Fetch this before generating a new list that is going to be cached
+	uint64_t getGeneration() const noexcept { return generation; }
+
+	uint64_t getHits() const noexcept { return hits; }
+	uint64_t getMisses() const noexcept { return misses; }
+
+	size_t getEntryCount() const noexcept;
+	size_t getTotalBytes() const noexcept;
+private:
+	typedef pair<Key, SharedBuffer> Entry;
+	typedef list<Entry> EntryList;
+
+	void removeEntry(EntryList::iterator aEntry) noexcept;
+
+	// Most recently used entries are at the front
+	EntryList entries;
+	unordered_map<Key, EntryList::iterator, KeyHash> index;
+
+	const size_t maxBytes;
+	const size_t maxEntries;
+	size_t totalBytes = 0;
+
+	atomic<uint64_t> generation { 0 };
+	atomic<uint64_t> hits { 0 };
+	atomic<uint64_t> misses { 0 };
+
+	mutable CriticalSection cs;
+};
+
+}
+
+#endif /* DCPLUSPLUS_DCPP_PARTIALLISTCACHE_H_ */
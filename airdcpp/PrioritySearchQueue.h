@@ -41,10 +41,11 @@ public:
 			return;
 		}
 
-		{
-			auto& queue = getQueue(aItem);
-			dcassert(find(queue.begin(), queue.end(), aItem) == queue.end());
-			queue.push_back(aItem);
+		if (aItem->isRecent()) {
+			dcassert(find(recentSearchQueue.begin(), recentSearchQueue.end(), aItem) == recentSearchQueue.end());
+			recentSearchQueue.push_back(aItem);
+		} else {
+			getPrioQueue(aItem).add(aItem);
 		}
 
 		recalculateSearchTimes(aItem->isRecent(), false);
@@ -55,8 +56,11 @@ public:
 			return;
 		}
 
-		auto& queue = getQueue(aItem);
-		queue.erase(remove(queue.begin(), queue.end(), aItem), queue.end());
+		if (aItem->isRecent()) {
+			recentSearchQueue.erase(remove(recentSearchQueue.begin(), recentSearchQueue.end(), aItem), recentSearchQueue.end());
+		} else {
+			getPrioQueue(aItem).remove(aItem);
+		}
 	}
 
 	// Get the next normal/recent item to search for and rotate the search queue
@@ -94,9 +98,10 @@ public:
 		auto& nextSearch = aRecent ? nextSearchRecent : nextSearchNormal;
 		const auto minIntervalMinutes = SettingsManager::getInstance()->get(minIntervalSetting);
 
+		// The intervals won't change after the item count exceeds the base interval so there's no need to count further
 		int calculatedIntervalMinutes = 0;
 		if (aRecent) {
-			auto itemCount = getValidItemCountRecent();
+			auto itemCount = getValidItemCountRecent(15 + 1);
 			if (itemCount == 0) {
 				nextSearch = 0;
 				return nextSearch;
@@ -104,7 +109,7 @@ public:
 
 			calculatedIntervalMinutes = max(15 / itemCount, minIntervalMinutes);
 		} else {
-			auto itemCount = getValidItemCountNormal();
+			auto itemCount = getValidItemCountNormal(nullptr, 60 + 1);
 			if (itemCount == 0) {
 				nextSearch = 0;
 				return nextSearch;
@@ -127,6 +132,68 @@ private:
 		bool operator()(const ItemT& aItem) const noexcept { return aItem->allowAutoSearch(); }
 	};
 
+	// Items with the same priority
+	// Provides constant time insertion, removal and random access. Items are searched for in a rotating order.
+	class PrioQueue {
+	public:
+		void add(const ItemT& aItem) noexcept {
+			dcassert(positions.find(&(*aItem)) == positions.end());
+			positions.emplace(&(*aItem), items.size());
+			items.push_back(aItem);
+		}
+
+		void remove(const ItemT& aItem) noexcept {
+			auto i = positions.find(&(*aItem));
+			if (i == positions.end()) {
+				return;
+			}
+
+			// Fill the gap with the last item
+			auto pos = i->second;
+			positions.erase(i);
+			if (pos != items.size() - 1) {
+				items[pos] = std::move(items.back());
+				positions[&(*items[pos])] = pos;
+			}
+
+			items.pop_back();
+		}
+
+		// Get the next item that can be searched for and rotate the queue
+		ItemT popNext() noexcept {
+			for (size_t i = 0; i < items.size(); i++) {
+				auto pos = (next + i) % items.size();
+				if (items[pos]->allowAutoSearch()) {
+					next = pos + 1;
+					return items[pos];
+				}
+			}
+
+			return nullptr;
+		}
+
+		int countValid(int aLimit) const noexcept {
+			int ret = 0;
+			for (auto i = items.begin(); i != items.end() && ret < aLimit; ++i) {
+				if ((*i)->allowAutoSearch()) {
+					ret++;
+				}
+			}
+
+			return ret;
+		}
+
+		const ItemT& get(size_t aPos) const noexcept { return items[aPos]; }
+		size_t size() const noexcept { return items.size(); }
+		bool empty() const noexcept { return items.empty(); }
+	private:
+		vector<ItemT> items;
+		unordered_map<const void*, size_t> positions;
+
+		// Position of the item that should be checked first when searching
+		size_t next = 0;
+	};
+
 	ItemT maybePopRecent() noexcept{
 		for (auto i = 0; i < static_cast<int>(recentSearchQueue.size()); i++) {
 			auto item = recentSearchQueue.front();
@@ -147,7 +214,47 @@ private:
 		return nullptr;
 	}
 
+	// Multiply with a priority factor to get bigger probability for items with higher priority
+	static int getPrioWeight(int aPrio) noexcept {
+		return aPrio - 1;
+	}
+
+	// Choose the priority queue by sampling weighted items randomly until one that can be searched for is found 
+	// (rejection sampling). The probability of each priority is the same as when weighting by the valid item counts, 
+	// without having to check every item.
 	ItemT maybePopNormal() noexcept{
+		size_t totalWeight = 0;
+		for (int p = static_cast<int>(Priority::LOW); p < static_cast<int>(Priority::LAST); p++) {
+			totalWeight += getPrioWeight(p) * prioSearchQueue[p].size();
+		}
+
+		if (totalWeight == 0) {
+			return nullptr;
+		}
+
+		uniform_int_distribution<size_t> dist(0, totalWeight - 1);
+		for (int attempt = 0; attempt < MAX_SAMPLING_ATTEMPTS; attempt++) {
+			auto pos = dist(gen);
+			for (int p = static_cast<int>(Priority::LOW); p < static_cast<int>(Priority::LAST); p++) {
+				auto& sbq = prioSearchQueue[p];
+				auto weight = getPrioWeight(p) * sbq.size();
+				if (pos < weight) {
+					if (sbq.get(pos / getPrioWeight(p))->allowAutoSearch()) {
+						return sbq.popNext();
+					}
+
+					break;
+				}
+
+				pos -= weight;
+			}
+		}
+
+		// Most items can't be searched for, check them all
+		return maybePopNormalExact();
+	}
+
+	ItemT maybePopNormalExact() noexcept{
 		ProbabilityList probabilities;
 		auto itemCount = getValidItemCountNormal(&probabilities);
 
@@ -163,32 +270,30 @@ private:
 		dcassert(!sbq.empty());
 
 		// Find the first item from the search queue that can be searched for
-		auto s = find_if(sbq.begin(), sbq.end(), AllowSearch());
-		if (s != sbq.end()) {
-			auto item = *s;
-			//move to the back
-			sbq.erase(s);
-			sbq.push_back(item);
-			return item;
-		}
-
-		return nullptr;
+		return sbq.popNext();
 	}
 
-	int getValidItemCountRecent() const noexcept {
-		return static_cast<int>(count_if(recentSearchQueue.begin(), recentSearchQueue.end(), AllowSearch()));
+	int getValidItemCountRecent(int aLimit = numeric_limits<int>::max()) const noexcept {
+		int ret = 0;
+		for (auto i = recentSearchQueue.begin(); i != recentSearchQueue.end() && ret < aLimit; ++i) {
+			if ((*i)->allowAutoSearch()) {
+				ret++;
+			}
+		}
+
+		return ret;
 	}
 
 	mt19937 gen;
 
-	int getValidItemCountNormal(ProbabilityList* probabilities_ = nullptr) const noexcept{
+	int getValidItemCountNormal(ProbabilityList* probabilities_ = nullptr, int aLimit = numeric_limits<int>::max()) const noexcept{
 		int itemCount = 0;
 		int p = static_cast<int>(Priority::LOW);
 		do {
-			int dequeItems = static_cast<int>(count_if(prioSearchQueue[p].begin(), prioSearchQueue[p].end(), AllowSearch()));
+			int dequeItems = prioSearchQueue[p].countValid(probabilities_ ? numeric_limits<int>::max() : aLimit - itemCount);
 
 			if (probabilities_) {
-				(*probabilities_).push_back((p - 1) * dequeItems); //multiply with a priority factor to get bigger probability for items with higher priority
+				(*probabilities_).push_back(getPrioWeight(p) * dequeItems);
 			}
 
 			itemCount += dequeItems;
@@ -198,15 +303,15 @@ private:
 		return itemCount;
 	}
 
-	typedef deque<ItemT> QueueType;
-
-	QueueType& getQueue(const ItemT& aItem) {
-		return aItem->isRecent() ? recentSearchQueue : prioSearchQueue[static_cast<int>(aItem->getPriority())];
+	PrioQueue& getPrioQueue(const ItemT& aItem) {
+		return prioSearchQueue[static_cast<int>(aItem->getPriority())];
 	}
 
+	static const int MAX_SAMPLING_ATTEMPTS = 32;
+
 	// Search items by priority (low-highest)
-	QueueType prioSearchQueue[static_cast<int>(Priority::LAST)];
-	QueueType recentSearchQueue;
+	PrioQueue prioSearchQueue[static_cast<int>(Priority::LAST)];
+	deque<ItemT> recentSearchQueue;
 
 	// Next normal search tick
 	uint64_t nextSearchNormal = GET_TICK() + (90 * 1000);
@@ -32,6 +32,7 @@
 #include "FileReader.h"
 #include "HashManager.h"
 #include "LogManager.h"
+#include "Metrics.h"
 #include "ResourceManager.h"
 #include "ScopedFunctor.h"
 #include "SearchManager.h"
@@ -412,7 +413,7 @@ bool QueueManager::recheckFileImpl(const string& aPath, bool isBundleCheck, int6
 
 void QueueManager::getBloom(HashBloom& bloom) const noexcept {
 	RLock l(cs);
-	fileQueue.getBloom(bloom);
+	bundleQueue.getBloom(bloom);
 }
 
 size_t QueueManager::getQueuedBundleFiles() const noexcept {
@@ -1263,6 +1264,7 @@ bool QueueManager::allowStartQI(const QueueItemPtr& aQI, const QueueTokenSet& ru
 bool QueueManager::startDownload(const UserPtr& aUser, const QueueTokenSet& runningBundles, const OrderedStringSet& onlineHubs,
 	QueueItemBase::DownloadType aType, int64_t aLastSpeed, string& lastError_) noexcept{
 
+	MetricTimer timer(Metrics::startDownloadTime);
 	bool hasDownload = false;
 	QueueItemPtr qi = nullptr;
 	{
@@ -1276,6 +1278,7 @@ bool QueueManager::startDownload(const UserPtr& aUser, const QueueTokenSet& runn
 pair<QueueItem::DownloadType, bool> QueueManager::startDownload(const UserPtr& aUser, string& hubHint, QueueItemBase::DownloadType aType, 
 	QueueToken& bundleToken, bool& allowUrlChange, bool& hasDownload, string& lastError_) noexcept{
 
+	MetricTimer timer(Metrics::startDownloadTime);
 	QueueTokenSet runningBundles;
 	DownloadManager::getInstance()->getRunningBundles(runningBundles);
 
@@ -3676,7 +3679,7 @@ MemoryInputStream* QueueManager::generateTTHList(QueueToken aBundleToken, bool i
 	if (tths.size() == 0) {
 		throw QueueException(UserConnection::FILE_NOT_AVAILABLE);
 	} else {
-		return new MemoryInputStream(tths);
+		return new MemoryInputStream(move(tths));
 	}
 }
 
@@ -144,7 +144,7 @@ int SSLSocket::read(void* aBuffer, int aBufLen) {
 	int len = checkSSL(SSL_read(ssl, aBuffer, aBufLen));
 
 	if(len > 0) {
-		stats.totalDown += len;
+		Metrics::socketBytesDown.add(len);
 		//dcdebug("In(s): %.*s\n", len, (char*)aBuffer);
 	}
 	return len;
@@ -156,7 +156,7 @@ int SSLSocket::write(const void* aBuffer, int aLen) {
 	}
 	int ret = checkSSL(SSL_write(ssl, aBuffer, aLen));
 	if(ret > 0) {
-		stats.totalUp += ret;
+		Metrics::socketBytesUp.add(ret);
 		//dcdebug("Out(s): %.*s\n", ret, (char*)aBuffer);
 	}
 	return ret;
@@ -30,7 +30,6 @@
 namespace dcpp {
 	atomic<SearchInstanceToken> searchInstanceIdCounter { 1 };
 	SearchInstance::SearchInstance(const string& aOwnerId, uint64_t aExpirationTick) : ownerId(aOwnerId), token(searchInstanceIdCounter++), expirationTick(aExpirationTick) {
-		SearchManager::getInstance()->addListener(this);
 		ClientManager::getInstance()->addListener(this);
 	}
 
@@ -38,7 +37,6 @@ namespace dcpp {
 		ClientManager::getInstance()->cancelSearch(this);
 
 		ClientManager::getInstance()->removeListener(this);
-		SearchManager::getInstance()->removeListener(this);
 	}
 
 	optional<int64_t> SearchInstance::getTimeToExpiration() const noexcept {
@@ -81,8 +79,11 @@ namespace dcpp {
 	void SearchInstance::reset(const SearchPtr& aSearch) noexcept {
 		ClientManager::getInstance()->cancelSearch(this);
 
+		string oldSearchToken;
+
 		{
 			WLock l(cs);
+			oldSearchToken = currentSearchToken;
 			currentSearchToken = aSearch->token;
 			curMatcher = shared_ptr<SearchQuery>(SearchQuery::getSearch(aSearch));
 			curParams = aSearch;
@@ -93,6 +94,7 @@ namespace dcpp {
 			filteredResultCount = 0;
 		}
 
+		SearchManager::getInstance()->setSearchInstanceToken(token, oldSearchToken, aSearch->token);
 		fire(SearchInstanceListener::Reset());
 	}
 
@@ -183,7 +185,7 @@ namespace dcpp {
 		}
 	}
 
-	void SearchInstance::on(SearchManagerListener::SR, const SearchResultPtr& aResult) noexcept {
+	void SearchInstance::onResult(const SearchResultPtr& aResult) noexcept {
 		auto matcher = curMatcher; // Increase the refs
 		if (!matcher) {
 			return;
@@ -23,7 +23,6 @@
 
 #include "ClientManagerListener.h"
 #include "SearchInstanceListener.h"
-#include "SearchManagerListener.h"
 
 #include "GroupedSearchResult.h"
 #include "Speaker.h"
@@ -31,7 +30,7 @@
 
 namespace dcpp {
 	struct SearchQueueInfo;
-	class SearchInstance : public Speaker<SearchInstanceListener>, private SearchManagerListener, private ClientManagerListener {
+	class SearchInstance : public Speaker<SearchInstanceListener>, private ClientManagerListener {
 	public:
 		SearchInstance(const string& aOwnerId, uint64_t aExpirationTick = 0);
 		~SearchInstance();
@@ -74,9 +73,11 @@ namespace dcpp {
 
 		optional<int64_t> getTimeToExpiration() const noexcept;
 
+		// Called by SearchManager for results that may match the current search
+		void onResult(const SearchResultPtr& aResult) noexcept;
+
 		IGETSET(bool, freeSlotsOnly, FreeSlotsOnly, false);
 	private:
-		void on(SearchManagerListener::SR, const SearchResultPtr& aResult) noexcept override;
 
 		GroupedSearchResult::Map results;
 		shared_ptr<SearchQuery> curMatcher;
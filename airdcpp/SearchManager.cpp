@@ -22,6 +22,7 @@
 #include "AdcHub.h"
 #include "AirUtil.h"
 #include "ClientManager.h"
+#include "Metrics.h"
 #include "QueueManager.h"
 #include "ResourceManager.h"
 #include "ScopedFunctor.h"
@@ -165,12 +166,64 @@ SearchInstancePtr SearchManager::removeSearchInstance(SearchInstanceToken aToken
 
 		ret = i->second;
 		searchInstances.erase(i);
+
+		for (auto t = searchTokenInstances.begin(); t != searchTokenInstances.end();) {
+			if (t->second == aToken) {
+				t = searchTokenInstances.erase(t);
+			} else {
+				++t;
+			}
+		}
 	}
 
 	fire(SearchManagerListener::SearchInstanceRemoved(), ret);
 	return ret;
 }
 
+void SearchManager::setSearchInstanceToken(SearchInstanceToken aInstance, const string& aOldSearchToken, const string& aNewSearchToken) noexcept {
+	WLock l(cs);
+	if (searchInstances.find(aInstance) == searchInstances.end()) {
+		return;
+	}
+
+	auto i = searchTokenInstances.find(aOldSearchToken);
+	if (i != searchTokenInstances.end() && i->second == aInstance) {
+		searchTokenInstances.erase(i);
+	}
+
+	if (!aNewSearchToken.empty()) {
+		searchTokenInstances[aNewSearchToken] = aInstance;
+	}
+}
+
+void SearchManager::onSearchResult(const SearchResultPtr& aResult) noexcept {
+	fire(SearchManagerListener::SR(), aResult);
+
+	SearchInstanceList instances;
+
+	{
+		RLock l(cs);
+		if (!aResult->getUser().user->isNMDC() && !aResult->getSearchToken().empty()) {
+			// ADC results can only match the instance with the same token
+			auto i = searchTokenInstances.find(aResult->getSearchToken());
+			if (i != searchTokenInstances.end()) {
+				auto instance = searchInstances.find(i->second);
+				dcassert(instance != searchInstances.end());
+				instances.push_back(instance->second);
+			}
+		} else {
+			// NMDC results must be matched manually
+			for (const auto& si : searchInstances | map_values) {
+				instances.push_back(si);
+			}
+		}
+	}
+
+	for (const auto& si : instances) {
+		si->onResult(aResult);
+	}
+}
+
 SearchInstancePtr SearchManager::getSearchInstance(SearchInstanceToken aToken) const noexcept {
 	RLock l(cs);
 	auto i = searchInstances.find(aToken);
@@ -324,7 +377,7 @@ void SearchManager::onSR(const string& x, const string& aRemoteIP /*Util::emptyS
 
 	auto sr = make_shared<SearchResult>(user, type, slots, freeSlots, size,
 		Util::toAdcFile(file), aRemoteIP, SettingsManager::lanMode ? TTHValue() : TTHValue(tth), Util::emptyString, 0, connection, DirectoryContentInfo());
-	fire(SearchManagerListener::SR(), sr);
+	onSearchResult(sr);
 }
 
 void SearchManager::onRES(const AdcCommand& cmd, const UserPtr& from, const string& remoteIp) {
@@ -340,19 +393,19 @@ void SearchManager::onRES(const AdcCommand& cmd, const UserPtr& from, const stri
 		if(str.compare(0, 2, "FN") == 0) {
 			adcPath = str.substr(2);
 		} else if(str.compare(0, 2, "SL") == 0) {
-			freeSlots = Util::toInt(str.substr(2));
+			freeSlots = Util::toInt(str.c_str() + 2);
 		} else if(str.compare(0, 2, "SI") == 0) {
-			size = Util::toInt64(str.substr(2));
+			size = Util::toInt64(str.c_str() + 2);
 		} else if(str.compare(0, 2, "TR") == 0) {
 			tth = str.substr(2);
 		} else if(str.compare(0, 2, "TO") == 0) {
 			token = str.substr(2);
 		} else if(str.compare(0, 2, "DM") == 0) {
-			date = Util::toTimeT(str.substr(2));
+			date = Util::toTimeT(str.c_str() + 2);
 		} else if(str.compare(0, 2, "FI") == 0) {
-			files = Util::toInt(str.substr(2));
+			files = Util::toInt(str.c_str() + 2);
 		} else if(str.compare(0, 2, "FO") == 0) {
-			folders = Util::toInt(str.substr(2));
+			folders = Util::toInt(str.c_str() + 2);
 		}
 	}
 
@@ -381,7 +434,7 @@ void SearchManager::onRES(const AdcCommand& cmd, const UserPtr& from, const stri
 		
 		auto sr = make_shared<SearchResult>(HintedUser(from, hubUrl), type, slots, (uint8_t)freeSlots, size,
 			adcPath, remoteIp, th, token, date, connection, DirectoryContentInfo(folders, files));
-		fire(SearchManagerListener::SR(), sr);
+		onSearchResult(sr);
 	}
 }
 
@@ -568,6 +621,9 @@ void SearchManager::onPSR(const AdcCommand& aCmd, UserPtr from, const string& re
 }
 
 void SearchManager::respond(const AdcCommand& adc, OnlineUser& aUser, bool isUdpActive, const string& hubIpPort, ProfileToken aProfile) {
+	MetricTimer responseTimer(Metrics::searchResponseTime);
+	Metrics::incomingSearches.add();
+
 	auto isDirect = adc.getType() == 'D';
 	string path = ADC_ROOT_STR, key;
 	int maxResults = isUdpActive ? 10 : 5;
@@ -589,6 +645,7 @@ void SearchManager::respond(const AdcCommand& adc, OnlineUser& aUser, bool isUdp
 	adc.getParam("TO", 0, token);
 
 	try {
+		MetricTimer searchTimer(Metrics::searchTime);
 		ShareManager::getInstance()->adcSearch(results, srch, aProfile, aUser.getUser()->getCID(), path, token.find("/as") != string::npos);
 	} catch(const ShareException& e) {
 		if (replyDirect) {
@@ -613,28 +670,37 @@ void SearchManager::respond(const AdcCommand& adc, OnlineUser& aUser, bool isUdp
 		bool reply = false, add = false;
 		QueueManager::getInstance()->handlePartialSearch(aUser.getUser(), TTHValue(tth), partialInfo, bundle, reply, add);
 
+		vector<AdcCommand> commands;
 		if (!partialInfo.empty()) {
 			//LogManager::getInstance()->message("SEARCH RESPOND: PARTIALINFO NOT EMPTY");
-			AdcCommand cmd = toPSR(isUdpActive, Util::emptyString, hubIpPort, tth, partialInfo);
-			ClientManager::getInstance()->sendUDP(cmd, aUser.getUser()->getCID(), false, true, Util::emptyString, aUser.getHubUrl());
+			commands.push_back(toPSR(isUdpActive, Util::emptyString, hubIpPort, tth, partialInfo));
 		}
 		
 		if (!bundle.empty()) {
 			//LogManager::getInstance()->message("SEARCH RESPOND: BUNDLE NOT EMPTY");
-			AdcCommand cmd = toPBD(hubIpPort, bundle, tth, reply, add);
-			ClientManager::getInstance()->sendUDP(cmd, aUser.getUser()->getCID(), false, true, Util::emptyString, aUser.getHubUrl());
+			commands.push_back(toPBD(hubIpPort, bundle, tth, reply, add));
+		}
+
+		if (!commands.empty()) {
+			ClientManager::getInstance()->sendUDP(commands, aUser.getUser()->getCID(), false, true, Util::emptyString, aUser.getHubUrl());
 		}
 
 		goto end;
 	}
 
+	if (!results.empty()) {
+		// Send all results at once
+		vector<AdcCommand> commands;
+		commands.reserve(results.size());
+		for(const auto& sr: results) {
+			commands.push_back(sr->toRES(AdcCommand::TYPE_UDP));
+			if(!token.empty())
+				commands.back().addParam("TO", token);
+		}
 
-	adc.getParam("KY", 0, key);
-	for(const auto& sr: results) {
-		AdcCommand cmd = sr->toRES(AdcCommand::TYPE_UDP);
-		if(!token.empty())
-			cmd.addParam("TO", token);
-		ClientManager::getInstance()->sendUDP(cmd, aUser.getUser()->getCID(), false, false, key, aUser.getHubUrl());
+		adc.getParam("KY", 0, key);
+		ClientManager::getInstance()->sendUDP(commands, aUser.getUser()->getCID(), false, false, key, aUser.getHubUrl());
+		Metrics::searchResultsSent.add(commands.size());
 	}
 
 end:
@@ -82,6 +82,8 @@ public:
 
 	void listen();
 	void disconnect() noexcept;
+	UDPServer::Stats getUdpStats() const noexcept { return udpServer.getStats(); }
+
 	void onSR(const string& aLine, const string& aRemoteIP=Util::emptyString);
 
 	void onRES(const AdcCommand& cmd, const UserPtr& from, const string& remoteIp);
@@ -112,7 +114,13 @@ public:
 	SearchInstancePtr removeSearchInstance(SearchInstanceToken aToken) noexcept;
 	SearchInstancePtr getSearchInstance(SearchInstanceToken aToken) const noexcept;
 	SearchInstanceList getSearchInstances() const noexcept;
+
+	// Route ADC results with the new search token to the instance
+	void setSearchInstanceToken(SearchInstanceToken aInstance, const string& aOldSearchToken, const string& aNewSearchToken) noexcept;
 private:
+	// Fire the result and pass it to the matching search instances
+	void onSearchResult(const SearchResultPtr& aResult) noexcept;
+
 	vector<pair<uint8_t*, uint64_t>> searchKeys;
 
 	mutable SharedMutex cs;
@@ -139,6 +147,9 @@ private:
 
 	typedef map<SearchInstanceToken, SearchInstancePtr> SearchInstanceMap;
 	SearchInstanceMap searchInstances;
+
+	// Search instances by the current search token
+	unordered_map<string, SearchInstanceToken> searchTokenInstances;
 };
 
 } // namespace dcpp
@@ -28,10 +28,12 @@
 #include "FilteredFile.h"
 #include "LogManager.h"
 #include "HashManager.h"
+#include "PartialListCache.h"
 #include "ResourceManager.h"
 #include "ScopedFunctor.h"
 #include "SearchResult.h"
 #include "SharePathValidator.h"
+#include "ShareSearchCache.h"
 #include "SimpleXML.h"
 #include "StringTokenizer.h"
 #include "Transfer.h"
@@ -58,13 +60,17 @@ using boost::range::remove_if;
 
 #define SHARE_CACHE_VERSION "3"
 
+// Maximum time to spend on matching a single search (ms)
+#define MAX_SEARCH_TIME 2000
+
 #ifdef ATOMIC_FLAG_INIT
 atomic_flag ShareManager::refreshing = ATOMIC_FLAG_INIT;
 #else
 atomic_flag ShareManager::refreshing;
 #endif
 
-ShareManager::ShareManager() : bloom(new ShareBloom(1 << 20)), validator(new SharePathValidator())
+ShareManager::ShareManager() : bloom(new ShareBloom(1 << 20)), validator(new SharePathValidator()), partialListCache(new PartialListCache(64 * 1024 * 1024, 1024)),
+	searchCache(new ShareSearchCache(512))
 { 
 	SettingsManager::getInstance()->addListener(this);
 	HashManager::getInstance()->addListener(this);
@@ -464,8 +470,7 @@ MemoryInputStream* ShareManager::getTree(const string& virtualFile, ProfileToken
 		}
 	}
 
-	ByteVector buf = tree.getLeafData();
-	return new MemoryInputStream(&buf[0], buf.size());
+	return new MemoryInputStream(tree.getLeafData());
 }
 
 AdcCommand ShareManager::getFileInfo(const string& aFile, ProfileToken aProfile) {
@@ -557,6 +562,7 @@ optional<TempShareInfo> ShareManager::addTempShare(const TTHValue& aTTH, const s
 
 		//didnt exist.. fine, add it.
 		tempShares.emplace(aTTH, item);
+		hashBloomCache.add(aTTH);
 	}
 
 	fire(ShareManagerListener::TempFileAdded(), item);
@@ -573,6 +579,7 @@ bool ShareManager::removeTempShare(const UserPtr& aUser, const TTHValue& tth) no
 			if (i->second.user == aUser) {
 				removedItem.emplace(i->second);
 				tempShares.erase(i);
+				onTTHRemoved(tth);
 				break;
 			}
 		}
@@ -602,6 +609,7 @@ bool ShareManager::removeTempShare(TempShareToken aId) noexcept {
 
 		removedItem.emplace(*i);
 		tempShares.erase(i.base());
+		onTTHRemoved(removedItem->tth);
 	}
 
 	fire(ShareManagerListener::TempFileRemoved(), *removedItem);
@@ -804,6 +812,8 @@ ShareManager::Directory::Ptr ShareManager::Directory::createNormal(DualString&&
 		if (!added) {
 			return nullptr;
 		}
+
+		aParent->addContentNames(NGramSummary(dir->realName.getLower()));
 	}
 
 	addDirName(dir, dirNameMap_, bloom);
@@ -832,11 +842,21 @@ bool ShareManager::Directory::setParent(const Directory::Ptr& aDirectory, const
 		}
 
 		aParent->updateModifyDate();
+
+		auto names = aDirectory->contentNames;
+		names.add(aDirectory->realName.getLower());
+		aParent->addContentNames(names);
 	}
 
 	return true;
 }
 
+void ShareManager::Directory::addContentNames(const NGramSummary& aNames) noexcept {
+	for (auto d = this; d; d = d->parent) {
+		d->contentNames.merge(aNames);
+	}
+}
+
 void ShareManager::Directory::cleanIndices(Directory& aDirectory, int64_t& sharedSize_, File::TTHMap& tthIndex_, Directory::MultiMap& dirNames_) noexcept {
 	aDirectory.cleanIndices(sharedSize_, tthIndex_, dirNames_);
 
@@ -854,6 +874,7 @@ void ShareManager::Directory::File::updateIndices(ShareBloom& bloom_, int64_t& s
 
 	tthIndex_.emplace(const_cast<TTHValue*>(&tth), this);
 	bloom_.add(name.getLower());
+	parent->addContentNames(NGramSummary(name.getLower()));
 }
 
 void ShareManager::Directory::cleanIndices(int64_t& sharedSize_, HashFileMap& tthIndex_, Directory::MultiMap& dirNames_) noexcept {
@@ -1157,6 +1178,16 @@ ShareManager::ShareSearchStats ShareManager::getSearchMatchingStats() const noex
 
 	stats.autoSearches = autoSearches;
 	stats.tthSearches = tthSearches;
+	stats.timedOutSearches = timedOutSearches;
+
+	stats.partialListCacheHits = partialListCache->getHits();
+	stats.partialListCacheMisses = partialListCache->getMisses();
+	stats.partialListCacheEntries = partialListCache->getEntryCount();
+	stats.partialListCacheSize = partialListCache->getTotalBytes();
+
+	stats.searchCacheHits = searchCache->getHits();
+	stats.searchCacheMisses = searchCache->getMisses();
+	stats.searchCacheEntries = searchCache->getEntryCount();
 
 	return stats;
 }
@@ -1199,17 +1230,24 @@ Incoming text searches: %d (of which %d were matched per second)\r\n\
 Filtered text searches: %d%% (%d%% of the matched ones returned results)\r\n\
 Average search tokens (non-filtered only): %d (%d bytes per token)\r\n\
 Auto searches (text, ADC only): %d%%\r\n\
-Average time for matching a recursive search: %d ms\r\n\
-TTH searches: %d%% (hash bloom mode: %s)")
+Average time for matching a recursive search: %d ms (%d searches timed out)\r\n\
+TTH searches: %d%% (hash bloom mode: %s)\r\n\
+Partial list cache: %d%% hit rate (%d hits, %d misses, %d lists cached, total size %s)\r\n\
+Search result cache: %d%% hit rate (%d hits, %d misses, %d searches cached)")
 
 		% searchStats.totalSearches % searchStats.totalSearchesPerSecond
 		% searchStats.recursiveSearches % searchStats.unfilteredRecursiveSearchesPerSecond
 		% Util::countPercentage(searchStats.filteredSearches, searchStats.recursiveSearches) % Util::countPercentage(searchStats.recursiveSearchesResponded, searchStats.recursiveSearches - searchStats.filteredSearches)
 		% searchStats.averageSearchTokenCount  % searchStats.averageSearchTokenLength
 		% Util::countAverage(searchStats.autoSearches, searchStats.recursiveSearches)
-		% searchStats.averageSearchMatchMs
+		% searchStats.averageSearchMatchMs % searchStats.timedOutSearches
 		% Util::countPercentage(searchStats.tthSearches, searchStats.totalSearches)
 		% (SETTING(BLOOM_MODE) != SettingsManager::BLOOM_DISABLED ? "Enabled" : "Disabled") // bloom mode
+		% Util::countPercentage(searchStats.partialListCacheHits, searchStats.partialListCacheHits + searchStats.partialListCacheMisses)
+		% searchStats.partialListCacheHits % searchStats.partialListCacheMisses
+		% searchStats.partialListCacheEntries % Util::formatBytes(searchStats.partialListCacheSize)
+		% Util::countPercentage(searchStats.searchCacheHits, searchStats.searchCacheHits + searchStats.searchCacheMisses)
+		% searchStats.searchCacheHits % searchStats.searchCacheMisses % searchStats.searchCacheEntries
 	);
 
 	return ret;
@@ -1415,6 +1453,16 @@ bool ShareManager::isFileShared(const TTHValue& aTTH, ProfileToken aProfile) con
 	return false;
 }
 
+void ShareManager::getProfileHashes(ProfileToken aProfile, vector<TTHValue>& tths_) const noexcept {
+	RLock l(cs);
+	tths_.reserve(tths_.size() + tthIndex.size());
+	for (const auto& i: tthIndex) {
+		if (i.second->getParent()->hasProfile(aProfile)) {
+			tths_.push_back(*i.first);
+		}
+	}
+}
+
 bool ShareManager::RefreshInfo::checkContent(const Directory::Ptr& aDirectory) noexcept {
 	if (SETTING(SKIP_EMPTY_DIRS_SHARE) && aDirectory->getDirectories().empty() && aDirectory->files.empty()) {
 		// Remove from parent
@@ -1867,6 +1915,9 @@ bool ShareManager::removeProfile(ProfileToken aToken) noexcept {
 
 		shareProfiles.erase(remove(shareProfiles.begin(), shareProfiles.end(), aToken), shareProfiles.end());
 	}
+
+	partialListCache->clear();
+	searchCache->invalidate();
 	
 	fire(ShareManagerListener::ProfileRemoved(), aToken); //removeRootDirectories() might take a while so fire listener first.
 	removeRootDirectories(removedPaths);
@@ -1890,6 +1941,9 @@ bool ShareManager::addRootDirectory(const ShareDirectoryInfoPtr& aDirectoryInfo)
 		}
 	}
 
+	partialListCache->clear();
+	searchCache->invalidate();
+
 	fire(ShareManagerListener::RootCreated(), path);
 	addRefreshTask(ADD_DIR, { path }, TYPE_MANUAL);
 
@@ -1920,9 +1974,13 @@ bool ShareManager::removeRootDirectory(const string& aPath) noexcept {
 
 		// Remove the root
 		Directory::cleanIndices(*sd, sharedSize, tthIndex, lowerDirNameMap);
+		hashBloomCache.setDirty();
 		File::deleteFile(sd->getRoot()->getCacheXmlPath());
 	}
 
+	partialListCache->clear();
+	searchCache->invalidate();
+
 	HashManager::getInstance()->stopHashing(aPath);
 
 	LogManager::getInstance()->message(STRING_F(SHARED_DIR_REMOVED, aPath), LogMessage::SEV_INFO);
@@ -1970,6 +2028,9 @@ bool ShareManager::updateRootDirectory(const ShareDirectoryInfoPtr& aDirectoryIn
 		}
 	}
 
+	partialListCache->clear();
+	searchCache->invalidate();
+
 	setProfilesDirty(dirtyProfiles, true);
 
 	fire(ShareManagerListener::RootUpdated(), aDirectoryInfo->path);
@@ -2241,9 +2302,13 @@ bool ShareManager::applyRefreshChanges(RefreshInfo& ri, int64_t& totalHash_, Pro
 		}
 
 		parent = ri.oldShareDirectory->getParent();
+		partialListCache->invalidate(ri.oldShareDirectory->getAdcPath());
 
 		// Remove the old directory
 		Directory::cleanIndices(*ri.oldShareDirectory, sharedSize, tthIndex, lowerDirNameMap);
+
+		// Checking each removed file wouldn't be much cheaper than rebuilding the blooms when they are needed
+		hashBloomCache.setDirty();
 	}
 
 	// Set the parent for refreshed subdirectories
@@ -2268,6 +2333,14 @@ bool ShareManager::applyRefreshChanges(RefreshInfo& ri, int64_t& totalHash_, Pro
 		}
 	}
 
+	partialListCache->invalidate(ri.newShareDirectory->getAdcPath());
+	searchCache->invalidate();
+	if (!ri.oldShareDirectory) {
+		for (const auto tth : ri.tthIndexNew | map_keys) {
+			hashBloomCache.add(*tth);
+		}
+	}
+
 	ri.mergeRefreshChanges(lowerDirNameMap, rootPaths, tthIndex, totalHash_, sharedSize, aDirtyProfiles);
 	dcdebug("Share changes applied for the directory %s\n", ri.path.c_str());
 	return true;
@@ -2329,11 +2402,19 @@ ShareDirectoryInfoList ShareManager::getRootInfos() const noexcept {
 		
 void ShareManager::getBloom(HashBloom& bloom_) const noexcept {
 	RLock l(cs);
-	for(const auto tth: tthIndex | map_keys)
-		bloom_.add(*tth);
+	hashBloomCache.get(bloom_, [this](HashBloom& aBloom) {
+		for(const auto tth: tthIndex | map_keys)
+			aBloom.add(*tth);
 
-	for(const auto& tth: tempShares | map_keys)
-		bloom_.add(tth);
+		for(const auto& tth: tempShares | map_keys)
+			aBloom.add(tth);
+	});
+}
+
+void ShareManager::onTTHRemoved(const TTHValue& aTTH) noexcept {
+	if (tthIndex.find(const_cast<TTHValue*>(&aTTH)) == tthIndex.end() && tempShares.find(aTTH) == tempShares.end()) {
+		hashBloomCache.setDirty();
+	}
 }
 
 string ShareManager::generateOwnList(ProfileToken aProfile) {
@@ -2417,6 +2498,16 @@ MemoryInputStream* ShareManager::generatePartialList(const string& aVirtualPath,
 		return 0;
 	}
 
+	PartialListCache::Key cacheKey(aProfile, aVirtualPath, aRecursive);
+	{
+		auto cached = partialListCache->get(cacheKey);
+		if (!cached.empty()) {
+			dcdebug("Partial list served from cache (%s)\n", aVirtualPath.c_str());
+			return new MemoryInputStream(cached);
+		}
+	}
+
+	auto cacheGeneration = partialListCache->getGeneration();
 	string xml = Util::emptyString;
 
 	{
@@ -2429,7 +2520,10 @@ MemoryInputStream* ShareManager::generatePartialList(const string& aVirtualPath,
 		return nullptr;
 	} else {
 		dcdebug("Partial list generated (%s)\n", aVirtualPath.c_str());
-		return new MemoryInputStream(xml);
+
+		SharedBuffer list(move(xml));
+		partialListCache->put(cacheKey, list, cacheGeneration);
+		return new MemoryInputStream(list);
 	}
 }
 
@@ -2744,7 +2838,7 @@ MemoryInputStream* ShareManager::generateTTHList(const string& dir, bool recurse
 		dcdebug("Partial NULL");
 		return nullptr;
 	} else {
-		return new MemoryInputStream(tths);
+		return new MemoryInputStream(move(tths));
 	}
 }
 
@@ -2822,12 +2916,47 @@ void ShareManager::nmdcSearch(SearchResultList& l, const string& nmdcString, int
 * but not the parents...
 */
 
-void ShareManager::Directory::search(SearchResultInfo::Set& results_, SearchQuery& aStrings, int aLevel) const noexcept{
+ShareManager::Directory::SearchContext::SearchContext(const SearchQuery& aSearch, uint64_t aDeadline) noexcept :
+	maxResults(aSearch.maxResults * 2), deadline(aDeadline) {
+
+	for (const auto& p : aSearch.include.getPatterns()) {
+		patternGrams.emplace_back(p.str());
+	}
+}
+
+void ShareManager::Directory::SearchContext::addResult(SearchResultInfo::Set& results_, const SearchResultInfo& aInfo) const noexcept {
+	results_.insert(aInfo);
+	if (results_.size() > maxResults) {
+		results_.erase(prev(results_.end()));
+	}
+}
+
+void ShareManager::Directory::search(SearchResultInfo::Set& results_, SearchQuery& aStrings, const SearchContext& aContext, int aLevel) const noexcept{
+	if (aContext.timedOut) {
+		return;
+	}
+
+	if (GET_TICK() > aContext.deadline) {
+		aContext.timedOut = true;
+		return;
+	}
+
 	const auto& dirName = getVirtualNameLower();
 	if (aStrings.isExcludedLower(dirName)) {
 		return;
 	}
 
+	// Skip the subtree if a pattern can't be found from this directory or any of its children
+	// (patterns may have been matched partially by the parents when a recursion exists)
+	if (!aStrings.recursion) {
+		const auto& patterns = aStrings.include.getPatterns();
+		for (size_t i = 0; i < patterns.size(); ++i) {
+			if (!contentNames.mayContain(aContext.patternGrams[i]) && patterns[i].matchLower(dirName) == string::npos) {
+				return;
+			}
+		}
+	}
+
 	auto old = aStrings.recursion;
 
 	unique_ptr<SearchQuery::Recursion> rec = nullptr;
@@ -2838,7 +2967,7 @@ void ShareManager::Directory::search(SearchResultInfo::Set& results_, SearchQuer
 		bool positionsComplete = aStrings.positionsComplete();
 		if (aStrings.itemType != SearchQuery::TYPE_FILE && positionsComplete && aStrings.gt == 0 && aStrings.matchesDate(lastWrite)) {
 			// Full match
-			results_.insert(Directory::SearchResultInfo(this, aStrings, aLevel));
+			aContext.addResult(results_, Directory::SearchResultInfo(this, aStrings, aLevel));
 			//if (aStrings.matchType == SearchQuery::MATCH_FULL_PATH) {
 			//	return;
 			//}
@@ -2877,7 +3006,7 @@ void ShareManager::Directory::search(SearchResultInfo::Set& results_, SearchQuer
 				continue;
 			}
 
-			results_.insert(Directory::SearchResultInfo(f, aStrings, aLevel));
+			aContext.addResult(results_, Directory::SearchResultInfo(f, aStrings, aLevel));
 			if (aStrings.addParents)
 				break;
 		}
@@ -2885,7 +3014,7 @@ void ShareManager::Directory::search(SearchResultInfo::Set& results_, SearchQuer
 
 	// Match directories
 	for(const auto& d: directories) {
-		d->search(results_, aStrings, aLevel);
+		d->search(results_, aStrings, aContext, aLevel);
 	}
 
 	// Moving to a lower level
@@ -2937,6 +3066,15 @@ void ShareManager::adcSearch(SearchResultList& results, SearchQuery& srch, const
 		}
 	}
 
+	auto cacheKey = ShareSearchCache::getKey(srch, aProfile, aDir);
+	if (searchCache->get(cacheKey, results)) {
+		if (!results.empty())
+			recursiveSearchesResponded++;
+		return;
+	}
+
+	auto cacheGeneration = searchCache->getGeneration();
+
 	// Get the search roots
 	Directory::List roots;
 	if (aDir == ADC_ROOT_STR) {
@@ -2946,11 +3084,37 @@ void ShareManager::adcSearch(SearchResultList& results, SearchQuery& srch, const
 	}
 
 	auto start = GET_TICK();
+	Directory::SearchContext context(srch, start + MAX_SEARCH_TIME);
 
 	// go them through recursively
+	vector<Directory::SearchResultInfo::Set> rootResults(roots.size());
+	if (roots.size() > 1) {
+		// Each root gets its own copy of the query as it stores the matching state
+		vector<size_t> rootIndexes(roots.size());
+		iota(rootIndexes.begin(), rootIndexes.end(), 0);
+
+		try {
+			parallel_for_each(rootIndexes.begin(), rootIndexes.end(), [&](size_t i) {
+				SearchQuery rootQuery(srch);
+				roots[i]->search(rootResults[i], rootQuery, context, 0);
+			});
+		} catch (std::exception& e) {
+			dcdebug("ShareManager::adcSearch: parallel search failed (%s)\n", e.what());
+		}
+	} else if (!roots.empty()) {
+		roots.front()->search(rootResults.front(), srch, context, 0);
+	}
+
+	// merge the best results from each root
 	Directory::SearchResultInfo::Set resultInfos;
-	for (const auto& d: roots) {
-		d->search(resultInfos, srch, 0);
+	for (const auto& infos: rootResults) {
+		for (const auto& info: infos) {
+			context.addResult(resultInfos, info);
+		}
+	}
+
+	if (context.timedOut) {
+		timedOutSearches++;
 	}
 
 	// update statistics
@@ -2971,6 +3135,10 @@ void ShareManager::adcSearch(SearchResultList& results, SearchQuery& srch, const
 		}
 	}
 
+	if (!context.timedOut) {
+		searchCache->put(cacheKey, results, cacheGeneration);
+	}
+
 	if (!results.empty())
 		recursiveSearchesResponded++;
 }
@@ -3114,7 +3282,24 @@ void ShareManager::onFileHashed(const string& fname, HashedFile& fileInfo) noexc
 			return;
 		}
 
-		addFile(Util::getFileName(fname), d, fileInfo, tthIndex, *bloom.get(), sharedSize, &dirtyProfiles);
+		DualString name(Util::getFileName(fname));
+
+		optional<TTHValue> replacedTTH;
+		{
+			auto i = d->files.find(name.getLower());
+			if (i != d->files.end() && (*i)->getTTH() != fileInfo.getRoot()) {
+				replacedTTH = (*i)->getTTH();
+			}
+		}
+
+		addFile(move(name), d, fileInfo, tthIndex, *bloom.get(), sharedSize, &dirtyProfiles);
+		partialListCache->invalidate(d->getAdcPath());
+		searchCache->invalidateDelayed();
+
+		hashBloomCache.add(fileInfo.getRoot());
+		if (replacedTTH) {
+			onTTHRemoved(*replacedTTH);
+		}
 	}
 
 	setProfilesDirty(dirtyProfiles, false);
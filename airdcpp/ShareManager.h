@@ -31,6 +31,7 @@
 #include "DupeType.h"
 #include "Exception.h"
 #include "HashBloom.h"
+#include "NGramSummary.h"
 #include "HashedFile.h"
 #include "MerkleTree.h"
 #include "Pointer.h"
@@ -50,6 +51,8 @@ namespace dcpp {
 class File;
 class OutputStream;
 class MemoryInputStream;
+class PartialListCache;
+class ShareSearchCache;
 class SearchQuery;
 class SharePathValidator;
 
@@ -162,6 +165,9 @@ public:
 
 	bool isFileShared(const TTHValue& aTTH) const noexcept;
 	bool isFileShared(const TTHValue& aTTH, ProfileToken aProfile) const noexcept;
+
+	// Hashes of all files in the profile (unsorted, may contain duplicates)
+	void getProfileHashes(ProfileToken aProfile, vector<TTHValue>& tths_) const noexcept;
 	bool isRealPathShared(const string& aPath) const noexcept;
 
 	// Returns true if the real path can be added in share
@@ -256,7 +262,13 @@ public:
 		double averageSearchTokenCount = 0;
 		double averageSearchTokenLength = 0;
 
-		uint64_t autoSearches = 0, tthSearches = 0;
+		uint64_t autoSearches = 0, tthSearches = 0, timedOutSearches = 0;
+
+		uint64_t partialListCacheHits = 0, partialListCacheMisses = 0;
+		size_t partialListCacheEntries = 0, partialListCacheSize = 0;
+
+		uint64_t searchCacheHits = 0, searchCacheMisses = 0;
+		size_t searchCacheEntries = 0;
 	};
 	ShareSearchStats getSearchMatchingStats() const noexcept;
 
@@ -330,8 +342,15 @@ private:
 	uint64_t searchTokenCount = 0;
 	uint64_t searchTokenLength = 0;
 	uint64_t autoSearches = 0;
+	uint64_t timedOutSearches = 0;
 	typedef BloomFilter<5> ShareBloom;
 
+	// Generated partial lists for the most commonly browsed directories
+	const unique_ptr<PartialListCache> partialListCache;
+
+	// Results for repeated recursive searches
+	const unique_ptr<ShareSearchCache> searchCache;
+
 	class RootDirectory : boost::noncopyable {
 		public:
 			typedef shared_ptr<RootDirectory> Ptr;
@@ -374,6 +393,13 @@ private:
 	typedef vector<RootDirectory::Ptr> RootDirectoryList;
 	unique_ptr<ShareBloom> bloom;
 
+	// Hash blooms requested by the hubs
+	mutable HashBloomCache hashBloomCache;
+
+	// The cached hash blooms must be rebuilt if the TTH is no longer shared
+	// Call after removing the TTH from the indices (requires a write lock)
+	void onTTHRemoved(const TTHValue& aTTH) noexcept;
+
 	struct FilelistDirectory;
 	class Directory : public intrusive_ptr_base<Directory> {
 	public:
@@ -493,7 +519,26 @@ private:
 
 		void getProfileInfo(ProfileToken aProfile, int64_t& totalSize, size_t& filesCount) const noexcept;
 
-		void search(SearchResultInfo::Set& aResults, SearchQuery& aStrings, int aLevel) const noexcept;
+		// aPatternGrams must contain the trigrams of each include pattern
+		// Shared state of a single search that may be run for multiple roots concurrently
+		struct SearchContext {
+			SearchContext(const SearchQuery& aSearch, uint64_t aDeadline) noexcept;
+
+			// Insert a result and drop the lowest scored ones that won't fit in the final result list
+			void addResult(SearchResultInfo::Set& results_, const SearchResultInfo& aInfo) const noexcept;
+
+			// Name summaries for each include pattern
+			vector<NGramSummary> patternGrams;
+
+			// Results to keep (leaving room for results that are going to be merged to the same path)
+			const size_t maxResults;
+
+			// Stop searching after this tick
+			const uint64_t deadline;
+			mutable atomic<bool> timedOut { false };
+		};
+
+		void search(SearchResultInfo::Set& aResults, SearchQuery& aStrings, const SearchContext& aContext, int aLevel) const noexcept;
 
 		void toFileList(FilelistDirectory& aListDir, bool aRecursive);
 		void toTTHList(OutputStream& tthList, string& tmp2, bool recursive) const;
@@ -540,6 +585,9 @@ private:
 	private:
 		void cleanIndices(int64_t& sharedSize_, File::TTHMap& tthIndex_, Directory::MultiMap& dirNames_) noexcept;
 
+		// Add content name trigrams for this directory and all its parents
+		void addContentNames(const NGramSummary& aNames) noexcept;
+
 		Directory* parent;
 		Set directories;
 
@@ -547,6 +595,10 @@ private:
 		int64_t size = 0;
 		RootDirectory::Ptr root;
 
+		// Names of all files and directories in the subtree (excluding the name of this directory)
+		// Removed content isn't cleared until the next refresh
+		NGramSummary contentNames;
+
 		Directory(DualString&& aRealName, const Ptr& aParent, time_t aLastWrite, const RootDirectory::Ptr& aRoot = nullptr);
 		friend void intrusive_ptr_release(intrusive_ptr_base<Directory>*);
 
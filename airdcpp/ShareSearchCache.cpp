@@ -0,0 +1,168 @@
+/*
+ * Copyright (C) 2012-2019 AirDC++ Project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include "stdinc.h"
+
+#include "SearchQuery.h"
+#include "ShareSearchCache.h"
+#include "TimerManager.h"
+#include "Util.h"
+
+namespace dcpp {
+
+// How long the results may stay cached after a delayed invalidation (ms)
+#define DELAYED_INVALIDATION_TIME 10000
+
+ShareSearchCache::ShareSearchCache(size_t aMaxEntries) noexcept : maxEntries(aMaxEntries) {
+
+}
+
+string ShareSearchCache::getKey(const SearchQuery& aSearch, const OptionalProfileToken& aProfile, const string& aVirtualPath) noexcept {
+	auto appendList = [](string& key_, StringList&& aList) {
+		// The order doesn't affect the results
+		sort(aList.begin(), aList.end());
+		for (const auto& s : aList) {
+			key_ += s;
+			key_ += '\n';
+		}
+
+		key_ += '\t';
+	};
+
+	string ret = Util::toString(aProfile ? *aProfile : -1) + '\t' + aVirtualPath + '\t';
+
+	// Relevance scores depend on the order of the include patterns
+	for (const auto& p : aSearch.include.getPatterns()) {
+		ret += p.str();
+		ret += '\n';
+	}
+	ret += '\t';
+
+	{
+		StringList excluded;
+		for (const auto& p : aSearch.exclude.getPatterns()) {
+			excluded.push_back(p.str());
+		}
+
+		appendList(ret, move(excluded));
+	}
+
+	appendList(ret, StringList(aSearch.ext));
+	appendList(ret, StringList(aSearch.noExt));
+
+	ret += Util::toString(aSearch.gt) + '\t' + Util::toString(aSearch.lt) + '\t';
+	ret += Util::toString(aSearch.minDate) + '\t' + Util::toString(aSearch.maxDate) + '\t';
+	ret += Util::toString(aSearch.maxResults) + '\t';
+	ret += Util::toString(static_cast<int>(aSearch.matchType)) + '\t';
+	ret += Util::toString(static_cast<int>(aSearch.itemType)) + '\t';
+	ret += aSearch.addParents ? '1' : '0';
+	return ret;
+}
+
+void ShareSearchCache::invalidate() noexcept {
+	invalidationTick = 0;
+	generation++;
+}
+
+void ShareSearchCache::invalidateDelayed() noexcept {
+	// Keep the earlier time so that continuous changes won't postpone the invalidation indefinitely
+	uint64_t none = 0;
+	invalidationTick.compare_exchange_strong(none, GET_TICK() + DELAYED_INVALIDATION_TIME);
+}
+
+void ShareSearchCache::checkDelayedInvalidation() noexcept {
+	auto tick = invalidationTick.load();
+	if (tick != 0 && tick <= GET_TICK() && invalidationTick.compare_exchange_strong(tick, 0)) {
+		generation++;
+	}
+}
+
+SearchResultPtr ShareSearchCache::CachedResult::toResult() const noexcept {
+	if (direct) {
+		return make_shared<SearchResult>(path);
+	}
+
+	return make_shared<SearchResult>(type, size, path, tth, date, contentInfo);
+}
+
+bool ShareSearchCache::get(const string& aKey, SearchResultList& results_) noexcept {
+	checkDelayedInvalidation();
+
+	CachedResultList cached;
+
+	{
+		Lock l(cs);
+		auto i = index.find(aKey);
+		if (i == index.end() || i->second->generation != generation) {
+			misses++;
+			return false;
+		}
+
+		// Move to front
+		entries.splice(entries.begin(), entries, i->second);
+
+		hits++;
+		cached = i->second->results;
+	}
+
+	// Get the current slot counts
+	for (const auto& r: cached) {
+		results_.push_back(r.toResult());
+	}
+
+	return true;
+}
+
+void ShareSearchCache::put(const string& aKey, const SearchResultList& aResults, uint64_t aGeneration) noexcept {
+	CachedResultList cached;
+	cached.reserve(aResults.size());
+	for (const auto& r: aResults) {
+		cached.emplace_back(*r);
+	}
+
+	Lock l(cs);
+	if (aGeneration != generation) {
+		return;
+	}
+
+	{
+		auto i = index.find(aKey);
+		if (i != index.end()) {
+			removeEntry(i->second);
+		}
+	}
+
+	entries.emplace_front(aKey, move(cached), aGeneration);
+	index.emplace(aKey, entries.begin());
+
+	while (entries.size() > maxEntries) {
+		removeEntry(prev(entries.end()));
+	}
+}
+
+void ShareSearchCache::removeEntry(EntryList::iterator aEntry) noexcept {
+	index.erase(aEntry->key);
+	entries.erase(aEntry);
+}
+
+size_t ShareSearchCache::getEntryCount() const noexcept {
+	Lock l(cs);
+	return entries.size();
+}
+
+}
@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2012-2019 AirDC++ Project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef DCPLUSPLUS_DCPP_SHARESEARCHCACHE_H_
+#define DCPLUSPLUS_DCPP_SHARESEARCHCACHE_H_
+
+#include "CriticalSection.h"
+#include "forward.h"
+#include "typedefs.h"
+
+#include "SearchResult.h"
+
+namespace dcpp {
+
+class SearchQuery;
+
+// Bounded LRU cache for results of recursive share searches
+// Identical searches are commonly repeated by auto search clients; the cached results
+// are discarded whenever the share generation is increased
+//
+// Only the share content of the results is cached, the results are created again for each
+// search so that the slot information is up to date
+class ShareSearchCache {
+public:
+	explicit ShareSearchCache(size_t aMaxEntries) noexcept;
+
+	// Key for a search that only contains the parameters affecting the result list
+	static string getKey(const SearchQuery& aSearch, const OptionalProfileToken& aProfile, const string& aVirtualPath) noexcept;
+
+	// Returns false if there are no valid results for the search
+	bool get(const string& aKey, SearchResultList& results_) noexcept;
+
+	// The results are stored only if the share hasn't changed after the generation
+	// was fetched (the results are possibly stale otherwise)
+	void put(const string& aKey, const SearchResultList& aResults, uint64_t aGeneration) noexcept;
+
+	// Must be called whenever the share content changes
+	void invalidate() noexcept;
+
+	// Invalidate the cache after a short delay
+	// Used for changes that arrive continuously (such as hashed files), which would make the cache useless otherwise
+	void invalidateDelayed() noexcept;
+
+	// Fetch this before performing a search that is going to be cached
+	uint64_t getGeneration() const noexcept { return generation; }
+
+	uint64_t getHits() const noexcept { return hits; }
+	uint64_t getMisses() const noexcept { return misses; }
+
+	size_t getEntryCount() const noexcept;
+private:
+	struct CachedResult {
+		explicit CachedResult(const SearchResult& aResult) noexcept : path(aResult.getAdcPath()), tth(aResult.getTTH()), size(aResult.getSize()),
+			date(aResult.getDate()), contentInfo(aResult.getContentInfo()), type(aResult.getType()), direct(!aResult.getUser().user) { }
+
+		SearchResultPtr toResult() const noexcept;
+
+		string path;
+		TTHValue tth;
+		int64_t size;
+		time_t date;
+		DirectoryContentInfo contentInfo;
+		SearchResult::Types type;
+
+		// Parent directory result without any share information (see SearchQuery::addParents)
+		bool direct;
+	};
+
+	typedef vector<CachedResult> CachedResultList;
+
+	struct Entry {
+		Entry(const string& aKey, CachedResultList&& aResults, uint64_t aGeneration) noexcept : key(aKey), results(move(aResults)), generation(aGeneration) { }
+
+		const string key;
+		const CachedResultList results;
+		const uint64_t generation;
+	};
+
+	// Applies a delayed invalidation if it's due
+	void checkDelayedInvalidation() noexcept;
+
+	typedef list<Entry> EntryList;
+
+	void removeEntry(EntryList::iterator aEntry) noexcept;
+
+	// Most recently used entries are at the front
+	EntryList entries;
+	unordered_map<string, EntryList::iterator> index;
+
+	const size_t maxEntries;
+
+	atomic<uint64_t> generation { 0 };
+
+	// Tick when the pending delayed invalidation should be applied (0 = none)
+	atomic<uint64_t> invalidationTick { 0 };
+	atomic<uint64_t> hits { 0 };
+	atomic<uint64_t> misses { 0 };
+
+	mutable CriticalSection cs;
+};
+
+}
+
+#endif /* DCPLUSPLUS_DCPP_SHARESEARCHCACHE_H_ */
@@ -32,6 +32,10 @@
 #endif
 #endif
 
+#ifndef _WIN32
+#include <poll.h>
+#endif
+
 #ifndef AI_ADDRCONFIG
 #define AI_ADDRCONFIG 0
 #endif
@@ -104,6 +108,84 @@ inline void setBlocking2(socket_t sock, bool block) noexcept {
 
 #endif
 
+enum {
+	EVENT_READ = 0x01,
+	EVENT_WRITE = 0x02
+};
+
+#ifdef _WIN32
+
+// Waits until any of the events occur for either of the sockets (invalid sockets are ignored)
+// Returns the ready events for each socket
+void waitSockets(socket_t aSock0, socket_t aSock1, int aEvents, uint64_t aMillis, int& ready0_, int& ready1_) {
+	timeval tv;
+	tv.tv_sec = static_cast<long>(aMillis / 1000);
+	tv.tv_usec = (aMillis % 1000) * 1000;
+
+	// Windows sets don't depend on the descriptor values so there's no FD_SETSIZE issue here
+	fd_set rfd, wfd;
+	FD_ZERO(&rfd);
+	FD_ZERO(&wfd);
+
+	for (auto sock: { aSock0, aSock1 }) {
+		if (sock == INVALID_SOCKET) {
+			continue;
+		}
+
+		if (aEvents & EVENT_READ) {
+			FD_SET(sock, &rfd);
+		}
+
+		if (aEvents & EVENT_WRITE) {
+			FD_SET(sock, &wfd);
+		}
+	}
+
+	check([&] { return ::select(0, (aEvents & EVENT_READ) ? &rfd : NULL, (aEvents & EVENT_WRITE) ? &wfd : NULL, NULL, &tv); });
+
+	auto getReady = [&](socket_t aSock) {
+		if (aSock == INVALID_SOCKET) {
+			return 0;
+		}
+
+		return ((aEvents & EVENT_READ) && FD_ISSET(aSock, &rfd) ? EVENT_READ : 0) | ((aEvents & EVENT_WRITE) && FD_ISSET(aSock, &wfd) ? EVENT_WRITE : 0);
+	};
+
+	ready0_ = getReady(aSock0);
+	ready1_ = getReady(aSock1);
+}
+
+#else
+
+// Waits until any of the events occur for either of the sockets (invalid sockets are ignored)
+// Returns the ready events for each socket
+void waitSockets(socket_t aSock0, socket_t aSock1, int aEvents, uint64_t aMillis, int& ready0_, int& ready1_) {
+	short events = ((aEvents & EVENT_READ) ? POLLIN : 0) | ((aEvents & EVENT_WRITE) ? POLLOUT : 0);
+
+	// Negative descriptors are ignored by poll
+	pollfd fds[2] = {
+		{ aSock0, events, 0 },
+		{ aSock1, events, 0 }
+	};
+
+	auto timeout = static_cast<int>(min(aMillis, static_cast<uint64_t>(numeric_limits<int>::max())));
+	check([&] { return ::poll(fds, 2, timeout); });
+
+	auto getReady = [&](const pollfd& aFd) {
+		// Errors are reported as ready so that they will be noticed by the following socket call (similar to select)
+		if (aFd.revents & (POLLERR | POLLHUP | POLLNVAL)) {
+			return aEvents;
+		}
+
+		return ((aFd.revents & POLLIN) ? EVENT_READ : 0) | ((aFd.revents & POLLOUT) ? EVENT_WRITE : 0);
+	};
+
+	ready0_ = getReady(fds[0]);
+	ready1_ = getReady(fds[1]);
+}
+
+#endif
+
 inline int getSocketOptInt2(socket_t sock, int option) {
 	int val;
 	socklen_t len = sizeof(val);
@@ -117,46 +199,28 @@ inline int setSocketOpt2(socket_t sock, int level, int option, int val) {
 }
 
 inline bool isConnected(socket_t sock) {
-	fd_set wfd;
-	struct timeval tv = { 0 };
-
-	FD_ZERO(&wfd);
-	FD_SET(sock, &wfd);
-
-    if(::select(static_cast<int>(sock) + 1, NULL, &wfd, NULL, &tv) == 1) {
-        if (getSocketOptInt2(sock, SO_ERROR) == 0) {
-            return true;
-        }
-    }
-
-	return false;
+	int ready = 0, unused = 0;
+	waitSockets(sock, INVALID_SOCKET, EVENT_WRITE, 0, ready, unused);
+	return ready && getSocketOptInt2(sock, SO_ERROR) == 0;
 }
 
 inline socket_t readable(socket_t sock0, socket_t sock1) {
-	// FD_SET for an invalid socket can cause a buffer overflow (at least on Linux)
 	if (sock0 == INVALID_SOCKET) {
 		return sock1;
 	} else if (sock1 == INVALID_SOCKET) {
 		return sock0;
 	}
 
-	fd_set rfd;
-	struct timeval tv = { 0 };
-
-	FD_ZERO(&rfd);
-	FD_SET(sock0, &rfd);
-	FD_SET(sock1, &rfd);
-
-    if(::select(static_cast<int>(std::max(sock0, sock1)) + 1, &rfd, NULL, NULL, &tv) > 0) {
-        return static_cast<int>(FD_ISSET(sock0, &rfd) ? sock0 : sock1);
-    }
-
-	return sock0;
+	int ready0 = 0, ready1 = 0;
+	waitSockets(sock0, sock1, EVENT_READ, 0, ready0, ready1);
+	return !ready0 && ready1 ? sock1 : sock0;
 }
 
 }
 
 Socket::addr Socket::udpAddr;
+unordered_map<string, Socket::CachedAddr> Socket::addrCache;
+FastCriticalSection Socket::addrCacheCS;
 socklen_t Socket::udpAddrLen;
 
 #ifdef _DEBUG
@@ -198,8 +262,6 @@ int Socket::getLastError() { return errno; }
 
 #endif
 
-Socket::Stats Socket::stats = { 0, 0 };
-
 static const uint32_t SOCKS_TIMEOUT = 30000;
 
 string SocketException::errorToString(int aError) noexcept {
@@ -547,7 +609,7 @@ int Socket::read(void* aBuffer, int aBufLen) {
 	}, true);
 
 	if(len > 0) {
-		stats.totalDown += len;
+		Metrics::socketBytesDown.add(len);
 	}
 
 	return len;
@@ -565,7 +627,7 @@ int Socket::read(void* aBuffer, int aBufLen, string &aIP) {
 
 	if(len > 0) {
 		aIP = resolveName(&remote_addr.sa, addr_length);
-		stats.totalDown += len;
+		Metrics::socketBytesDown.add(len);
 	} else {
 		aIP.clear();
 	}
@@ -573,6 +635,51 @@ int Socket::read(void* aBuffer, int aBufLen, string &aIP) {
 	return len;
 }
 
+int Socket::readDatagrams(Datagram* const* aDatagrams, int aCount) {
+	dcassert(type == TYPE_UDP);
+	dcassert(aCount > 0);
+
+#ifdef __linux__
+	const int MAX_BATCH = 64;
+	aCount = min(aCount, MAX_BATCH);
+
+	mmsghdr msgs[MAX_BATCH];
+	iovec iovecs[MAX_BATCH];
+	addr remoteAddrs[MAX_BATCH];
+
+	memset(msgs, 0, sizeof(mmsghdr) * aCount);
+	for (int i = 0; i < aCount; ++i) {
+		auto& d = *aDatagrams[i];
+		iovecs[i].iov_base = d.buf.data();
+		iovecs[i].iov_len = d.buf.size();
+
+		msgs[i].msg_hdr.msg_iov = &iovecs[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+		msgs[i].msg_hdr.msg_name = &remoteAddrs[i].sa;
+		msgs[i].msg_hdr.msg_namelen = sizeof(addr);
+	}
+
+	// Don't wait for the whole batch to fill up
+	auto count = check([&] {
+		return ::recvmmsg(readable(sock4, sock6), msgs, aCount, MSG_DONTWAIT, nullptr);
+	}, true);
+
+	for (int i = 0; i < count; ++i) {
+		auto& d = *aDatagrams[i];
+		d.len = static_cast<int>(msgs[i].msg_len);
+		d.ip = resolveName(&remoteAddrs[i].sa, msgs[i].msg_hdr.msg_namelen);
+		Metrics::socketBytesDown.add(d.len);
+	}
+
+	return count;
+#else
+	// The socket may be in blocking mode so further reads can't be attempted
+	auto& d = *aDatagrams[0];
+	d.len = read(d.buf.data(), static_cast<int>(d.buf.size()), d.ip);
+	return d.len < 0 ? -1 : 1;
+#endif
+}
+
 int Socket::readAll(void* aBuffer, int aBufLen, uint64_t timeout) {
 	uint8_t* buf = (uint8_t*)aBuffer;
 	int i = 0;
@@ -604,7 +711,7 @@ void Socket::writeAll(const void* aBuffer, int aLen, uint64_t timeout) {
 			wait(timeout, false, true);
 		} else {
 			pos+=i;
-			stats.totalUp += i;
+			Metrics::socketBytesUp.add(i);
 		}
 	}
 }
@@ -612,7 +719,7 @@ void Socket::writeAll(const void* aBuffer, int aLen, uint64_t timeout) {
 int Socket::write(const void* aBuffer, int aLen) {
 	auto sent = check([&] { return ::send(getSock(), (const char*)aBuffer, aLen, 0); }, true);
 	if(sent > 0) {
-		stats.totalUp += sent;
+		Metrics::socketBytesUp.add(sent);
 	}
 	return sent;
 }
@@ -652,15 +759,17 @@ void Socket::writeTo(const string& aAddr, const string& aPort, const void* aBuff
 			connStr.push_back((uint8_t)aAddr.size());
 			connStr.insert(connStr.end(), aAddr.begin(), aAddr.end());
 		} else {
-			auto ai = resolveAddr(aAddr, aPort);
+			addr sa;
+			socklen_t saLen;
+			resolveDatagramAddr(aAddr, aPort, sa, saLen);
 
-			if(ai->ai_family == AF_INET) {
+			if(sa.sa.sa_family == AF_INET) {
 				connStr.push_back(1);		// Address type: IPv4
-				uint8_t* paddr = (uint8_t*)&((sockaddr_in*)ai->ai_addr)->sin_addr;
+				uint8_t* paddr = (uint8_t*)&sa.sai.sin_addr;
 				connStr.insert(connStr.end(), paddr, paddr+4);
-			} else if(ai->ai_family == AF_INET6) {
+			} else if(sa.sa.sa_family == AF_INET6) {
 				connStr.push_back(4);		// Address type: IPv6
-				uint8_t* paddr = (uint8_t*)&((sockaddr_in6*)ai->ai_addr)->sin6_addr;
+				uint8_t* paddr = (uint8_t*)&sa.sai6.sin6_addr;
 				connStr.insert(connStr.end(), paddr, paddr+16);
 			}
 		}
@@ -670,90 +779,174 @@ void Socket::writeTo(const string& aAddr, const string& aPort, const void* aBuff
 		sent = check([&] { return ::sendto(udpAddr.sa.sa_family == AF_INET ? sock4 : sock6,
 			(const char*)&connStr[0], (int)connStr.size(), 0, &udpAddr.sa, udpAddrLen); });
 	} else {
-		auto ai = resolveAddr(aAddr, aPort);
-		if((ai->ai_family == AF_INET && !sock4.valid()) || (ai->ai_family == AF_INET6 && !sock6.valid())) {
-			create(*ai);
-		}
-		sent = check([&] { return ::sendto(ai->ai_family == AF_INET ? sock4 : sock6,
-			(const char*)aBuffer, (int)aLen, 0, ai->ai_addr, ai->ai_addrlen); });
+		addr sa;
+		socklen_t saLen;
+		auto sock = getDatagramSocket(aAddr, aPort, sa, saLen);
+		sent = check([&] { return ::sendto(sock, (const char*)aBuffer, (int)aLen, 0, &sa.sa, saLen); });
 	}
 
-	stats.totalUp += sent;
+	Metrics::socketBytesUp.add(sent);
 }
 
-/**
- * Blocks until timeout is reached one of the specified conditions have been fulfilled
- * @param millis Max milliseconds to block.
- * @param checkRead Check for reading
- * @param checkWrite Check for writing
- * @return pair with read/write state respectively
- * @throw SocketException Select or the connection attempt failed.
- */
-std::pair<bool, bool> Socket::wait(uint64_t millis, bool checkRead, bool checkWrite) {
-	timeval tv;
-	tv.tv_sec = static_cast<long>(millis / 1000);
-	tv.tv_usec = (millis % 1000) * 1000;
-	fd_set rfd, wfd;
-	fd_set *rfdp = NULL, *wfdp = NULL;
-
-	int nfds = -1;
-
-	if(checkRead) {
-		rfdp = &rfd;
-		FD_ZERO(rfdp);
-		if(sock4.valid()) {
-			FD_SET(sock4, &rfd);
-			nfds = std::max((int)sock4, nfds);
+#define MAX_CACHED_ADDRESSES 128
+#define ADDRESS_CACHE_TIME 5*60*1000
+
+void Socket::resolveDatagramAddr(const string& aAddr, const string& aPort, addr& addr_, socklen_t& addrLen_) const {
+	// Addresses coming from user identities are IP literals that can be parsed without the resolver
+	auto port = Util::toInt(aPort);
+	if (port > 0 && port <= 65535) {
+		memzero(&addr_, sizeof(addr));
+		if (inet_pton(AF_INET, aAddr.c_str(), &addr_.sai.sin_addr) == 1) {
+			addr_.sai.sin_family = AF_INET;
+			addr_.sai.sin_port = htons(static_cast<uint16_t>(port));
+			addrLen_ = sizeof(sockaddr_in);
+			return;
 		}
 
-		if(sock6.valid()) {
-			FD_SET(sock6, &rfd);
-			nfds = std::max((int)sock6, nfds);
+		if (inet_pton(AF_INET6, aAddr.c_str(), &addr_.sai6.sin6_addr) == 1) {
+			addr_.sai6.sin6_family = AF_INET6;
+			addr_.sai6.sin6_port = htons(static_cast<uint16_t>(port));
+			addrLen_ = sizeof(sockaddr_in6);
+			return;
 		}
 	}
 
-	if(checkWrite) {
-		wfdp = &wfd;
-		FD_ZERO(wfdp);
-		if(sock4.valid()) {
-			FD_SET(sock4, &wfd);
-			nfds = std::max((int)sock4, nfds);
+	// Host names
+	// Changed addresses will get a new key so there's no need for explicit invalidation
+	auto key = aAddr + ":" + aPort;
+	auto tick = GET_TICK();
+
+	{
+		FastLock l(addrCacheCS);
+		auto i = addrCache.find(key);
+		if (i != addrCache.end() && i->second.expires > tick) {
+			addr_ = i->second.address;
+			addrLen_ = i->second.len;
+			return;
 		}
+	}
 
-		if(sock6.valid()) {
-			FD_SET(sock6, &wfd);
-			nfds = std::max((int)sock6, nfds);
+	auto ai = resolveAddr(aAddr, aPort);
+	memzero(&addr_, sizeof(addr));
+	memcpy(&addr_, ai->ai_addr, min(static_cast<size_t>(ai->ai_addrlen), sizeof(addr)));
+	addrLen_ = static_cast<socklen_t>(ai->ai_addrlen);
+
+	{
+		FastLock l(addrCacheCS);
+		if (addrCache.size() >= MAX_CACHED_ADDRESSES) {
+			for (auto i = addrCache.begin(); i != addrCache.end();) {
+				if (i->second.expires <= tick) {
+					i = addrCache.erase(i);
+				} else {
+					++i;
+				}
+			}
+
+			if (addrCache.size() >= MAX_CACHED_ADDRESSES) {
+				addrCache.clear();
+			}
 		}
+
+		addrCache[key] = { addr_, addrLen_, tick + ADDRESS_CACHE_TIME };
 	}
+}
+
+socket_t Socket::getDatagramSocket(const string& aAddr, const string& aPort, addr& addr_, socklen_t& addrLen_) {
+	resolveDatagramAddr(aAddr, aPort, addr_, addrLen_);
 
-	check([&] { return ::select(nfds + 1, rfdp, wfdp, NULL, &tv); });
+	auto family = addr_.sa.sa_family;
+	if ((family == AF_INET && !sock4.valid()) || (family == AF_INET6 && !sock6.valid())) {
+		addrinfo ai = { 0 };
+		ai.ai_family = family;
+		ai.ai_socktype = SOCK_DGRAM;
+		ai.ai_protocol = type;
+		create(ai);
+	}
 
-	return std::make_pair(
-		rfdp && ((sock4.valid() && FD_ISSET(sock4, rfdp)) || (sock6.valid() && FD_ISSET(sock6, rfdp))),
-		wfdp && ((sock4.valid() && FD_ISSET(sock4, wfdp)) || (sock6.valid() && FD_ISSET(sock6, wfdp))));
+	return family == AF_INET ? sock4 : sock6;
 }
 
-bool Socket::waitConnected(uint64_t millis) {
-	timeval tv;
-	tv.tv_sec = static_cast<long>(millis / 1000);
-	tv.tv_usec = (millis % 1000) * 1000;
-	fd_set fd;
-	FD_ZERO(&fd);
+void Socket::writeTo(const string& aAddr, const string& aPort, const StringList& aDatagrams, bool proxy) {
+	if (aDatagrams.empty())
+		return;
 
-	int nfds = -1;
-	if(sock4.valid()) {
-		FD_SET(sock4, &fd);
-		nfds = static_cast<int>(sock4);
+	if (aDatagrams.size() == 1 || (proxy && CONNSETTING(OUTGOING_CONNECTIONS) == SettingsManager::OUTGOING_SOCKS5)) {
+		for (const auto& d: aDatagrams) {
+			writeTo(aAddr, aPort, d.data(), static_cast<int>(d.length()), proxy);
+		}
+		return;
 	}
 
-	if(sock6.valid()) {
-		FD_SET(sock6, &fd);
-		nfds = std::max(static_cast<int>(sock6), nfds);
+	if (aAddr.empty() || aPort.empty()) {
+		throw SocketException(EADDRNOTAVAIL);
 	}
 
-	check([&] { return ::select(nfds + 1, NULL, &fd, NULL, &tv); });
+	// Resolve only once
+	addr sa;
+	socklen_t saLen;
+	auto sock = getDatagramSocket(aAddr, aPort, sa, saLen);
+
+#ifdef __linux__
+	const size_t MAX_BATCH = 64;
+	mmsghdr msgs[MAX_BATCH];
+	iovec iovecs[MAX_BATCH];
+
+	for (size_t pos = 0; pos < aDatagrams.size();) {
+		auto count = min(aDatagrams.size() - pos, MAX_BATCH);
+
+		memset(msgs, 0, sizeof(mmsghdr) * count);
+		for (size_t i = 0; i < count; ++i) {
+			const auto& d = aDatagrams[pos + i];
+			iovecs[i].iov_base = const_cast<char*>(d.data());
+			iovecs[i].iov_len = d.length();
+
+			msgs[i].msg_hdr.msg_iov = &iovecs[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+			msgs[i].msg_hdr.msg_name = &sa.sa;
+			msgs[i].msg_hdr.msg_namelen = saLen;
+		}
+
+		// Not all datagrams are necessarily sent with a single call
+		auto sent = check([&] { return ::sendmmsg(sock, msgs, static_cast<unsigned int>(count), 0); });
+		if (sent <= 0) {
+			break;
+		}
+
+		for (int i = 0; i < sent; ++i) {
+			Metrics::socketBytesUp.add(msgs[i].msg_len);
+		}
+
+		pos += sent;
+	}
+#else
+	for (const auto& d: aDatagrams) {
+		auto sent = check([&] { return ::sendto(sock, d.data(), static_cast<int>(d.length()), 0, &sa.sa, saLen); });
+		Metrics::socketBytesUp.add(sent);
+	}
+#endif
+}
+
+/**
+ * Blocks until timeout is reached one of the specified conditions have been fulfilled
+ * @param millis Max milliseconds to block.
+ * @param checkRead Check for reading
+ * @param checkWrite Check for writing
+ * @return pair with read/write state respectively
+ * @throw SocketException Select or the connection attempt failed.
+ */
+std::pair<bool, bool> Socket::wait(uint64_t millis, bool checkRead, bool checkWrite) {
+	int ready4 = 0, ready6 = 0;
+	waitSockets(sock4, sock6, (checkRead ? EVENT_READ : 0) | (checkWrite ? EVENT_WRITE : 0), millis, ready4, ready6);
+
+	auto ready = ready4 | ready6;
+	return std::make_pair((ready & EVENT_READ) != 0, (ready & EVENT_WRITE) != 0);
+}
+
+bool Socket::waitConnected(uint64_t millis) {
+	int ready4 = 0, ready6 = 0;
+	waitSockets(sock4, sock6, EVENT_WRITE, millis, ready4, ready6);
 
-	if(sock6.valid() && FD_ISSET(sock6, &fd)) {
+	if(ready6) {
 		int err6 = getSocketOptInt2(sock6, SO_ERROR);
 		if(err6 == 0) {
 			sock4.reset(); // We won't be needing this any more...
@@ -767,7 +960,7 @@ bool Socket::waitConnected(uint64_t millis) {
 		sock6.reset();
 	}
 
-	if(sock4.valid() && FD_ISSET(sock4, &fd)) {
+	if(ready4) {
 		int err4 = getSocketOptInt2(sock4, SO_ERROR);
 		if(err4 == 0) {
 			sock6.reset(); // We won't be needing this any more...
@@ -41,7 +41,9 @@ const int INVALID_SOCKET = -1;
 #define SOCKET_ERROR -1
 #endif
 
+#include "CriticalSection.h"
 #include "GetSet.h"
+#include "Metrics.h"
 #include "Util.h"
 #include "Exception.h"
 
@@ -170,6 +172,8 @@ public:
 	int write(const string& aData) { return write(aData.data(), (int)aData.length()); }
 	virtual void writeTo(const string& aIp, const string& aPort, const void* aBuffer, int aLen, bool proxy = true);
 	void writeTo(const string& aIp, const string& aPort, const string& aData) { writeTo(aIp, aPort, aData.data(), (int)aData.length()); }
+	/** Sends each string as a separate datagram to the same destination, using as few system calls as the platform allows */
+	void writeTo(const string& aIp, const string& aPort, const StringList& aDatagrams, bool proxy = true);
 	virtual void shutdown() noexcept;
 	virtual void close() noexcept;
 	void disconnect() noexcept;
@@ -194,6 +198,22 @@ public:
 	 * @throw SocketException On any failure.
 	 */
 	virtual int read(void* aBuffer, int aBufLen, string &aIP);
+
+	struct Datagram {
+		Datagram(size_t aBufSize) : buf(aBufSize) { }
+
+		ByteVector buf;
+		int len = 0;
+		string ip;
+	};
+
+	/**
+	 * Reads up to aCount queued datagrams, using a single system call where supported.
+	 * The data is stored in the preallocated buffers of the datagrams.
+	 * @return Number of datagrams read and -1 if the call would block.
+	 * @throw SocketException On any failure.
+	 */
+	int readDatagrams(Datagram* const* aDatagrams, int aCount);
 	/**
 	 * Reads data until aBufLen bytes have been read or an error occurs.
 	 * If the socket is closed, or the timeout is reached, the number of bytes read
@@ -207,8 +227,8 @@ public:
 	static string resolve(const string& aDns, int af = AF_UNSPEC) noexcept;
 	addrinfo_p resolveAddr(const string& name, const string& port, int family = AF_UNSPEC, int flags = 0) const;
 
-	static uint64_t getTotalDown() { return stats.totalDown; }
-	static uint64_t getTotalUp() { return stats.totalUp; }
+	static uint64_t getTotalDown() { return Metrics::socketBytesDown.get(); }
+	static uint64_t getTotalUp() { return Metrics::socketBytesUp.get(); }
 
 	void setBlocking(bool block) noexcept;
 
@@ -262,16 +282,25 @@ protected:
 
 	SocketType type;
 
-	class Stats {
-	public:
-		uint64_t totalDown;
-		uint64_t totalUp;
-	};
-	static Stats stats;
 
 	static addr udpAddr;
 	static socklen_t udpAddrLen;
 private:
+	// Resolve an UDP destination (IP literals are parsed directly and resolved host names are cached)
+	void resolveDatagramAddr(const string& aAddr, const string& aPort, addr& addr_, socklen_t& addrLen_) const;
+
+	// Resolve an UDP destination and create a socket for the address family if needed
+	socket_t getDatagramSocket(const string& aAddr, const string& aPort, addr& addr_, socklen_t& addrLen_);
+
+	struct CachedAddr {
+		addr address;
+		socklen_t len;
+		uint64_t expires;
+	};
+
+	static unordered_map<string, CachedAddr> addrCache;
+	static FastCriticalSection addrCacheCS;
+
 	void connect(const string& aAddr, const string& aPort, const string& localPort, string& lastError_);
 	void socksAuth(uint64_t timeout);
 	socket_t setSock(socket_t s, int af);
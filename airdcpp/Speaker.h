@@ -20,6 +20,11 @@
 #define DCPLUSPLUS_DCPP_SPEAKER_H
 
 #include <boost/range/algorithm/find.hpp>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
 #include <utility>
 #include <vector>
 
@@ -31,52 +36,213 @@ namespace dcpp {
 using std::vector;
 using boost::range::find;
 
+// Listeners are kept in an immutable snapshot that is replaced on every modification (copy-on-write)
+// so that firing requires neither the listener lock nor copying of the listener list
+//
+// Removing a listener waits until other threads have finished dispatching the old snapshots, meaning
+// that the listener is never called after removeListener has returned. Dispatches of the calling thread
+// aren't waited for (that would deadlock), and neither are dispatches of threads that are blocked in a
+// removal of the same speaker themselves. Such dispatches skip the listeners removed in the meantime.
 template<typename Listener>
 class Speaker {
 	typedef vector<Listener*> ListenerList;
 
+	struct Snapshot {
+		Snapshot() { }
+		explicit Snapshot(const ListenerList& aListeners) : listeners(aListeners) { }
+
+		const ListenerList listeners;
+
+		// Threads dispatching this snapshot
+		std::atomic<int> dispatchers { 0 };
+
+		// Dispatchers that are waiting in a removal themselves
+		std::atomic<int> parked { 0 };
+
+		// The snapshot has been replaced
+		std::atomic<bool> retired { false };
+	};
+
+	typedef std::shared_ptr<Snapshot> SnapshotPtr;
+	typedef vector<SnapshotPtr> SnapshotList;
+
 public:
-	Speaker() noexcept { }
+	Speaker() noexcept : snapshot(std::make_shared<Snapshot>()), currentSnapshot(snapshot.get()) { }
 	virtual ~Speaker() { 
-		dcassert(listeners.empty());
+		dcassert(getListenerCount() == 0);
 	}
 
 	template<typename... ArgT>
 	void fire(ArgT&&... args) noexcept {
-		Lock l(listenerCS);
-		tmpListeners = listeners;
-		for(auto listener: tmpListeners) {
+		SnapshotPtr current;
+		for (;;) {
+			current = std::atomic_load(&snapshot);
+			if (current->listeners.empty()) {
+				return;
+			}
+
+			current->dispatchers++;
+			if (currentSnapshot.load() == current.get()) {
+				break;
+			}
+
+			// Replaced before we were registered, removals may not have waited for us
+			releaseDispatch(*current);
+		}
+
+		auto& dispatches = getThreadDispatches();
+		dispatches.emplace_back(this, current.get());
+		for(auto listener: current->listeners) {
+			if (current->retired.load(std::memory_order_acquire) && !hasListener(listener)) {
+				continue;
+			}
+
 			listener->on(std::forward<ArgT>(args)...);
 		}
+
+		dispatches.pop_back();
+		releaseDispatch(*current);
 	}
 
 	void addListener(Listener* aListener) noexcept {
 		Lock l(listenerCS);
-		if(find(listeners, aListener) == listeners.end())
-			listeners.push_back(aListener);
+		auto current = std::atomic_load(&snapshot);
+		if (find(current->listeners, aListener) == current->listeners.end()) {
+			auto newListeners = current->listeners;
+			newListeners.push_back(aListener);
+			replaceSnapshot(newListeners);
+		}
 	}
 
 	void removeListener(Listener* aListener) noexcept {
-		Lock l(listenerCS);
-		auto it = find(listeners, aListener);
-		if(it != listeners.end())
-			listeners.erase(it);
+		SnapshotList pending;
+
+		{
+			Lock l(listenerCS);
+			auto current = std::atomic_load(&snapshot);
+			auto it = find(current->listeners, aListener);
+			if (it == current->listeners.end()) {
+				return;
+			}
+
+			auto newListeners = current->listeners;
+			newListeners.erase(newListeners.begin() + (it - current->listeners.begin()));
+			pending = replaceSnapshot(newListeners);
+		}
+
+		waitDispatches(pending);
 	}
 
 	bool hasListener(Listener* aListener) const noexcept {
-		Lock l(listenerCS);
-		return find(listeners, aListener) != listeners.end();
+		auto current = std::atomic_load(&snapshot);
+		return find(current->listeners, aListener) != current->listeners.end();
+	}
+
+	size_t getListenerCount() const noexcept {
+		return std::atomic_load(&snapshot)->listeners.size();
 	}
 
 	void removeListeners() noexcept {
-		Lock l(listenerCS);
-		listeners.clear();
+		SnapshotList pending;
+
+		{
+			Lock l(listenerCS);
+			pending = replaceSnapshot(ListenerList());
+		}
+
+		waitDispatches(pending);
 	}
-	
-protected:
-	ListenerList listeners;
-	ListenerList tmpListeners;
+
+private:
+	// Returns the replaced snapshots that are still being dispatched
+	// Must be called while holding the listener lock
+	SnapshotList replaceSnapshot(const ListenerList& aListeners) noexcept {
+		auto old = std::atomic_load(&snapshot);
+		auto newSnapshot = std::make_shared<Snapshot>(aListeners);
+		currentSnapshot.store(newSnapshot.get());
+		std::atomic_store(&snapshot, newSnapshot);
+		old->retired.store(true, std::memory_order_release);
+		retired.push_back(old);
+
+		// Dispatches can't start using a replaced snapshot (see fire), so idle ones are done with
+		retired.erase(std::remove_if(retired.begin(), retired.end(), [](const SnapshotPtr& s) { 
+			return s->dispatchers == 0; 
+		}), retired.end());
+
+		return retired;
+	}
+
+	void releaseDispatch(Snapshot& aSnapshot) noexcept {
+		aSnapshot.dispatchers--;
+		if (waiters > 0) {
+			notifyWaiters();
+		}
+	}
+
+	void notifyWaiters() noexcept {
+		{
+			std::lock_guard<std::mutex> l(waitMutex);
+		}
+
+		waitCondition.notify_all();
+	}
+
+	// Wait until the pending snapshots are no longer being dispatched by other threads
+	void waitDispatches(const SnapshotList& aPending) noexcept {
+		if (aPending.empty()) {
+			return;
+		}
+
+		// Our own dispatches (and those of other waiting threads) mustn't be waited for
+		auto& dispatches = getThreadDispatches();
+		for (const auto& d: dispatches) {
+			if (d.first == this) {
+				d.second->parked++;
+			}
+		}
+
+		waiters++;
+		notifyWaiters();
+
+		{
+			std::unique_lock<std::mutex> l(waitMutex);
+			waitCondition.wait(l, [&] {
+				return std::all_of(aPending.begin(), aPending.end(), [](const SnapshotPtr& s) { 
+					return s->dispatchers == s->parked; 
+				});
+			});
+		}
+
+		waiters--;
+		for (const auto& d: dispatches) {
+			if (d.first == this) {
+				d.second->parked--;
+			}
+		}
+	}
+
+	typedef vector<std::pair<const Speaker*, Snapshot*>> DispatchList;
+
+	// Speakers being dispatched in the current thread
+	static DispatchList& getThreadDispatches() noexcept {
+		static thread_local DispatchList dispatches;
+		return dispatches;
+	}
+
+	SnapshotPtr snapshot;
+
+	// Address of the current snapshot for cheap comparisons
+	std::atomic<const Snapshot*> currentSnapshot;
+
+	// Replaced snapshots that may still be dispatched (guarded by the listener lock)
+	SnapshotList retired;
+
+	// Serializes modifications
 	mutable CriticalSection listenerCS;
+
+	std::mutex waitMutex;
+	std::condition_variable waitCondition;
+	std::atomic<int> waiters { 0 };
 };
 
 } // namespace dcpp
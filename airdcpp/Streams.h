@@ -88,32 +88,61 @@ public:
 	virtual InputStream* releaseRootStream() { return this; }
 };
 
-class MemoryInputStream : public InputStream {
+/**
+ * Immutable, reference counted byte buffer. The data can be shared between
+ * multiple readers (e.g. MemoryInputStreams) without copying it.
+ */
+class SharedBuffer {
 public:
-	MemoryInputStream(const uint8_t* src, size_t len) : pos(0), size(len), buf(new uint8_t[len]) {
-		memcpy(buf, src, len);
-	}
-	MemoryInputStream(const string& src) : pos(0), size(src.size()), buf(new uint8_t[src.size()]) {
-		memcpy(buf, src.data(), src.size());
+	SharedBuffer() { }
+	SharedBuffer(const uint8_t* aSrc, size_t aLen) : SharedBuffer(ByteVector(aSrc, aSrc + aLen)) { }
+
+	explicit SharedBuffer(string&& aSrc) {
+		auto holder = make_shared<const string>(move(aSrc));
+		data = reinterpret_cast<const uint8_t*>(holder->data());
+		size = holder->size();
+		owner = move(holder);
 	}
 
-	~MemoryInputStream() {
-		delete[] buf;
+	explicit SharedBuffer(ByteVector&& aSrc) {
+		auto holder = make_shared<const ByteVector>(move(aSrc));
+		data = holder->data();
+		size = holder->size();
+		owner = move(holder);
 	}
 
+	const uint8_t* getData() const noexcept { return data; }
+	size_t getSize() const noexcept { return size; }
+	bool empty() const noexcept { return size == 0; }
+private:
+	shared_ptr<const void> owner;
+	const uint8_t* data = nullptr;
+	size_t size = 0;
+};
+
+class MemoryInputStream : public InputStream {
+public:
+	MemoryInputStream(const uint8_t* src, size_t len) : buf(src, len) { }
+	MemoryInputStream(const string& src) : buf(string(src)) { }
+
+	// Adopt the data without copying it
+	MemoryInputStream(string&& src) : buf(move(src)) { }
+	MemoryInputStream(ByteVector&& src) : buf(move(src)) { }
+	MemoryInputStream(const SharedBuffer& src) : buf(src) { }
+
 	size_t read(void* tgt, size_t& len) override {
-		len = min(len, size - pos);
-		memcpy(tgt, buf+pos, len);
+		len = min(len, buf.getSize() - pos);
+		memcpy(tgt, buf.getData() + pos, len);
 		pos += len;
 		return len;
 	}
 
-	size_t getSize() const { return size; }
+	size_t getSize() const { return buf.getSize(); }
+	const SharedBuffer& getBuffer() const noexcept { return buf; }
 
 private:
-	size_t pos;
-	size_t size;
-	uint8_t* buf;
+	size_t pos = 0;
+	const SharedBuffer buf;
 };
 
 class IOStream : public InputStream, public OutputStream {
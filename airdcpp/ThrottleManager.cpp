@@ -30,20 +30,82 @@ namespace dcpp {
 
 	#define CONDWAIT_TIMEOUT		250
 
+	// Maximum amount of unused tokens that can be accumulated (ms)
+	#define MAX_BURST_TIME			100
+
+	// Smallest amount of data that is worth a socket call
+	#define MIN_SLICE				1024
+
 	// constructor
 	ThrottleManager::ThrottleManager(void)
 	{
-		TimerManager::getInstance()->addListener(this);
+
 	}
 
 	// destructor
 	ThrottleManager::~ThrottleManager()
 	{
-		TimerManager::getInstance()->removeListener(this);
 
-		// release conditional variables on exit
-		downCond.notify_all();
-		upCond.notify_all();
+	}
+
+	void ThrottleManager::TokenBucket::refill(int64_t aRate, uint64_t aTick) noexcept {
+		auto last = lastRefill.load();
+		if (aTick <= last || !lastRefill.compare_exchange_strong(last, aTick)) {
+			// Up to date or refilled by another thread
+			return;
+		}
+
+		auto elapsed = static_cast<int64_t>(min(aTick - last, static_cast<uint64_t>(MAX_BURST_TIME)));
+		auto capacity = aRate * MAX_BURST_TIME;
+
+		auto cur = tokens.load();
+		int64_t next;
+		do {
+			next = max(cur, min(cur + aRate * elapsed, capacity));
+		} while (!tokens.compare_exchange_weak(cur, next));
+	}
+
+	int64_t ThrottleManager::TokenBucket::consume(int64_t aWanted, int64_t aRate, uint64_t aTick) noexcept {
+		refill(aRate, aTick);
+
+		auto cur = tokens.load();
+		while (cur >= 1000) {
+			auto taken = min(cur / 1000, aWanted);
+			if (tokens.compare_exchange_weak(cur, cur - taken * 1000)) {
+				return taken;
+			}
+		}
+
+		return 0;
+	}
+
+	void ThrottleManager::TokenBucket::refund(int64_t aBytes) noexcept {
+		tokens += aBytes * 1000;
+	}
+
+	void ThrottleManager::TokenBucket::settleWrite(int64_t aGranted, int aSent) noexcept {
+		if (aSent >= 0 && aSent < aGranted) {
+			refund(aGranted - aSent);
+		}
+	}
+
+	uint64_t ThrottleManager::TokenBucket::getWaitTime(int64_t aWanted, int64_t aRate) const noexcept {
+		auto missing = aWanted * 1000 - tokens.load();
+		if (missing <= 0) {
+			return 0;
+		}
+
+		return static_cast<uint64_t>((missing + aRate - 1) / aRate);
+	}
+
+	int64_t ThrottleManager::getSlice(int64_t aRate, size_t aConnections) noexcept {
+		// Share the burst evenly between the connections
+		return max(aRate * MAX_BURST_TIME / 1000 / static_cast<int64_t>(aConnections), static_cast<int64_t>(MIN_SLICE));
+	}
+
+	void ThrottleManager::waitTokens(const TokenBucket& aBucket, int64_t aWanted, int64_t aRate) noexcept {
+		auto waitTime = aBucket.getWaitTime(aWanted, aRate);
+		Thread::sleep(max(static_cast<uint64_t>(1), min(waitTime, static_cast<uint64_t>(CONDWAIT_TIMEOUT))));
 	}
 
 	/*
@@ -52,34 +114,25 @@ namespace dcpp {
 	int ThrottleManager::read(Socket* sock, void* buffer, size_t len)
 	{
 		size_t downs = DownloadManager::getInstance()->getTotalDownloadConnectionCount();
-		if (getDownLimit() == 0 || downs == 0)
+		int64_t rate = static_cast<int64_t>(getDownLimit()) * 1024;
+		if (rate == 0 || downs == 0)
 			return sock->read(buffer, len);
 
-		unique_lock<mutex> lock(downMutex);
-
-
-		if(downTokens > 0)
-		{
-			size_t slice = (getDownLimit() * 1024) / downs;
-			size_t readSize = min(slice, min(len, downTokens));
-				
-			// read from socket
-			readSize = sock->read(buffer, readSize);
-				
-			if(readSize > 0)
-				downTokens -= readSize;
-
-			// next code can't be in critical section, so we must unlock here
-			lock.unlock();
+		auto wanted = min(static_cast<int64_t>(len), getSlice(rate, downs));
+		auto granted = downBucket.consume(wanted, rate, GET_TICK());
+		if (granted == 0) {
+			// no tokens, wait for them
+			waitTokens(downBucket, wanted, rate);
+			return -1;	// from BufferedSocket: -1 = retry, 0 = connection close
+		}
 
-			// give a chance to other transfers to get a token
-			Thread::yield();
-			return readSize;
+		// No locks are held while reading
+		auto readSize = sock->read(buffer, static_cast<int>(granted));
+		if (readSize < granted) {
+			downBucket.refund(granted - max(readSize, 0));
 		}
 
-		// no tokens, wait for them
-		downCond.wait_for(lock, std::chrono::milliseconds(CONDWAIT_TIMEOUT));
-		return -1;	// from BufferedSocket: -1 = retry, 0 = connection close
+		return readSize;
 	}
 	
 	/*
@@ -89,31 +142,25 @@ namespace dcpp {
 	int ThrottleManager::write(Socket* sock, void* buffer, size_t& len)
 	{
 		size_t ups = UploadManager::getInstance()->getUploadCount();
-		if(getUpLimit() == 0 || ups == 0)
+		int64_t rate = static_cast<int64_t>(getUpLimit()) * 1024;
+		if(rate == 0 || ups == 0)
 			return sock->write(buffer, len);
 		
-		unique_lock<mutex> lock(upMutex);
-		
-		if(upTokens > 0)
-		{
-			size_t slice = (getUpLimit() * 1024) / ups;
-			len = min(slice, min(len, upTokens));
-			upTokens -= len;
+		auto wanted = min(static_cast<int64_t>(len), getSlice(rate, ups));
+		auto granted = upBucket.consume(wanted, rate, GET_TICK());
+		if (granted == 0) {
+			// no tokens, wait for them
+			waitTokens(upBucket, wanted, rate);
+			return 0;	// from BufferedSocket: -1 = failed, 0 = retry
+		}
 
-			// next code can't be in critical section, so we must unlock here
-			lock.unlock();
+		// The same buffer size must be used when retrying (OpenSSL)
+		len = static_cast<size_t>(granted);
 
-			// write to socket			
-			int sent = sock->write(buffer, len);
+		int sent = sock->write(buffer, len);
+		upBucket.settleWrite(granted, sent);
 
-			// give a chance to other transfers to get a token
-			Thread::yield();
-			return sent;
-		}
-		
-		// no tokens, wait for them
-		upCond.wait_for(lock, std::chrono::milliseconds(CONDWAIT_TIMEOUT));
-		return 0;	// from BufferedSocket: -1 = failed, 0 = retry
+		return sent;
 	}
 
 	void ThrottleManager::setSetting(SettingsManager::IntSetting setting, int value) noexcept {
@@ -163,26 +210,4 @@ namespace dcpp {
 		}
 	}
 
-	// TimerManagerListener
-	void ThrottleManager::on(TimerManagerListener::Second, uint64_t /*aTick*/) noexcept {
-		auto downLimit = getDownLimit() * 1024;
-		auto upLimit = getUpLimit() * 1024;
-		
-		// readd tokens
-		if(downLimit > 0)
-		{
-			lock_guard<mutex> lock(downMutex);
-			downTokens = downLimit;
-			downCond.notify_all();
-		}
-			
-		if(upLimit > 0)
-		{
-			lock_guard<mutex> lock(upMutex);
-			upTokens = upLimit;
-			upCond.notify_all();
-		}
-	}
-
-
 }	// namespace dcpp
\ No newline at end of file
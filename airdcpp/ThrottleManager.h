@@ -21,10 +21,6 @@
 
 #include "Singleton.h"
 #include "SettingsManager.h"
-#include "TimerManagerListener.h"
-
-#include <condition_variable>
-#include <mutex>
 
 
 namespace dcpp
@@ -35,7 +31,7 @@ namespace dcpp
 	 * Inspired by Token Bucket algorithm: http://en.wikipedia.org/wiki/Token_bucket
 	 */
 	class ThrottleManager :
-		public Singleton<ThrottleManager>, private TimerManagerListener
+		public Singleton<ThrottleManager>
 	{
 	public:
 
@@ -64,17 +60,40 @@ namespace dcpp
 		static void setSetting(SettingsManager::IntSetting setting, int value) noexcept;
 
 		static const int MAX_LIMIT = 1024 * 1024; // 1 GiB/s
+
+		/*
+		 * Lock-free token bucket that is refilled based on the elapsed time whenever tokens are requested
+		 * Tokens are stored as thousandths of a byte so that no fractions are lost with frequent refills
+		 */
+		class TokenBucket {
+		public:
+			// Take up to aWanted bytes, returns the number of bytes taken (0 if the bucket is empty)
+			int64_t consume(int64_t aWanted, int64_t aRate, uint64_t aTick) noexcept;
+
+			// Return unused bytes
+			void refund(int64_t aBytes) noexcept;
+
+			// Return the bytes that a write didn't use
+			// Nothing is returned for writes that would block (-1) as BufferedSocket retries them with the same
+			// buffer directly with the socket (OpenSSL), meaning that the tokens stay reserved for the retry
+			void settleWrite(int64_t aGranted, int aSent) noexcept;
+
+			// Milliseconds until the wanted amount of bytes is available
+			uint64_t getWaitTime(int64_t aWanted, int64_t aRate) const noexcept;
+		private:
+			void refill(int64_t aRate, uint64_t aTick) noexcept;
+
+			atomic<int64_t> tokens { 0 };
+			atomic<uint64_t> lastRefill { 0 };
+		};
+
+		// Maximum amount of bytes a connection may take at once
+		static int64_t getSlice(int64_t aRate, size_t aConnections) noexcept;
 	private:
-		
-		// download limiter
-		size_t						downTokens = 0;
-		condition_variable	downCond;
-		mutex				downMutex;
-		
-		// upload limiter
-		size_t						upTokens = 0;
-		condition_variable	upCond;
-		mutex				upMutex;
+		static void waitTokens(const TokenBucket& aBucket, int64_t aWanted, int64_t aRate) noexcept;
+
+		TokenBucket downBucket;
+		TokenBucket upBucket;
 			
 		friend class Singleton<ThrottleManager>;
 		
@@ -83,10 +102,6 @@ namespace dcpp
 
 		// destructor
 		~ThrottleManager();
-		
-		// TimerManagerListener
-		void on(TimerManagerListener::Second, uint64_t aTick) noexcept;
-				
 	};
 
 }	// namespace dcpp
@@ -31,7 +31,7 @@ TimerManager::TimerManager() {
 }
 
 TimerManager::~TimerManager() {
-	dcassert(listeners.size() == 0);
+	dcassert(getListenerCount() == 0);
 }
 
 void TimerManager::shutdown() {
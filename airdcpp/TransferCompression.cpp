@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2012-2019 AirDC++ Project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include "stdinc.h"
+#include "TransferCompression.h"
+
+#include "AdcCommand.h"
+#include "FilteredFile.h"
+#include "Text.h"
+#include "ZUtils.h"
+#include "ZstdUtils.h"
+
+namespace dcpp {
+
+bool TransferCompression::isSupported(Codec aCodec) noexcept {
+	switch (aCodec) {
+		case CODEC_ZLIB: return true;
+#ifdef HAVE_ZSTD
+		case CODEC_ZSTD: return true;
+#endif
+		default: return false;
+	}
+}
+
+const char* TransferCompression::getFlag(Codec aCodec) noexcept {
+	switch (aCodec) {
+		case CODEC_ZLIB: return "ZL";
+		case CODEC_ZSTD: return "ZS";
+		default: return nullptr;
+	}
+}
+
+void TransferCompression::addFlag(AdcCommand& aCmd, Codec aCodec) noexcept {
+	auto flag = getFlag(aCodec);
+	if (flag) {
+		aCmd.addParam(string(flag) + "1");
+	}
+}
+
+TransferCompression::Codec TransferCompression::parseCodec(const AdcCommand& aCmd) noexcept {
+	if (isSupported(CODEC_ZSTD) && aCmd.hasFlag(getFlag(CODEC_ZSTD), 4)) {
+		return CODEC_ZSTD;
+	}
+
+	if (aCmd.hasFlag(getFlag(CODEC_ZLIB), 4)) {
+		return CODEC_ZLIB;
+	}
+
+	return CODEC_NONE;
+}
+
+InputStream* TransferCompression::createCompressor(Codec aCodec, InputStream* aStream) {
+	switch (aCodec) {
+		case CODEC_ZLIB: return new FilteredInputStream<ZFilter, true>(aStream);
+#ifdef HAVE_ZSTD
+		case CODEC_ZSTD: return new FilteredInputStream<ZstdFilter, true>(aStream);
+#endif
+		default: return aStream;
+	}
+}
+
+OutputStream* TransferCompression::createDecompressor(Codec aCodec, OutputStream* aStream) {
+	switch (aCodec) {
+		case CODEC_ZLIB: return new FilteredOutputStream<UnZFilter, true>(aStream);
+#ifdef HAVE_ZSTD
+		case CODEC_ZSTD: return new FilteredOutputStream<UnZstdFilter, true>(aStream);
+#endif
+		default: return aStream;
+	}
+}
+
+bool TransferCompression::isCompressedExtension(const string& aPath) noexcept {
+	// Must be sorted alphabetically
+	static const StringList extensions = {
+		".7z", ".aac", ".ape", ".avi", ".bz2", ".cab", ".deb", ".docx", ".epub", ".flac", ".flv", ".gif", ".gz", ".iso", ".jar", ".jpeg", ".jpg",
+		".lz", ".lzma", ".m2ts", ".m4a", ".m4v", ".mkv", ".mov", ".mp3", ".mp4", ".mpeg", ".mpg", ".ogg", ".opus", ".png", ".rar", ".rpm",
+		".tbz2", ".tgz", ".txz", ".webm", ".webp", ".wmv", ".xlsx", ".xz", ".zip", ".zst"
+	};
+
+	auto ext = Text::toLower(Util::getFileExt(aPath));
+	if (ext.empty()) {
+		return false;
+	}
+
+	// Split RAR volumes (.r00, .r01...)
+	if (ext.size() == 4 && ext[1] == 'r' && isdigit(ext[2]) && isdigit(ext[3])) {
+		return true;
+	}
+
+	return binary_search(extensions.begin(), extensions.end(), ext);
+}
+
+} // namespace dcpp
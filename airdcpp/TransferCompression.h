@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2012-2019 AirDC++ Project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef DCPLUSPLUS_DCPP_TRANSFER_COMPRESSION_H
+#define DCPLUSPLUS_DCPP_TRANSFER_COMPRESSION_H
+
+#include "typedefs.h"
+
+namespace dcpp {
+
+class AdcCommand;
+class InputStream;
+class OutputStream;
+
+// Compression codecs for ADC transfers (GET/SND flags ZL1 and ZS1)
+class TransferCompression {
+public:
+	enum Codec : uint8_t {
+		CODEC_NONE,
+		CODEC_ZLIB,
+		CODEC_ZSTD
+	};
+
+	// Whether the codec has been compiled in
+	static bool isSupported(Codec aCodec) noexcept;
+
+	// Returns the GET/SND flag for the codec (without the value)
+	static const char* getFlag(Codec aCodec) noexcept;
+
+	// Add the flag for the codec in a command
+	static void addFlag(AdcCommand& aCmd, Codec aCodec) noexcept;
+
+	// Returns the preferred supported codec that has been flagged in the command
+	static Codec parseCodec(const AdcCommand& aCmd) noexcept;
+
+	// Wrap the stream for compression/decompression
+	// The stream is returned as such for CODEC_NONE
+	static InputStream* createCompressor(Codec aCodec, InputStream* aStream);
+	static OutputStream* createDecompressor(Codec aCodec, OutputStream* aStream);
+
+	// Extensions of formats that are compressed already
+	// Other data is assumed to be compressible, the compressors will fall back to storing incompressible data
+	static bool isCompressedExtension(const string& aPath) noexcept;
+};
+
+} // namespace dcpp
+
+#endif // !defined(DCPLUSPLUS_DCPP_TRANSFER_COMPRESSION_H)
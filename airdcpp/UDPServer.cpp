@@ -26,9 +26,12 @@
 #include "ResourceManager.h"
 #include "SearchManager.h"
 #include "SettingsManager.h"
+#include "TimerManager.h"
 #include "UDPServer.h"
 #include "UploadManager.h"
 
+#include <thread>
+
 
 namespace dcpp {
 
@@ -62,23 +65,108 @@ void UDPServer::disconnect() {
 	}
 }
 
-UDPServer::UDPServer() : stop(false), pp(true) { }
+UDPServer::UDPServer() : stop(false) {
+	auto workerCount = max(1u, min(std::thread::hardware_concurrency(), 4u));
+	for (auto i = 0u; i < workerCount; ++i) {
+		workers.push_back(make_unique<Worker>());
+	}
+}
+
 UDPServer::~UDPServer() { }
 
+UDPServer::Stats UDPServer::getStats() const noexcept {
+	return { receivedPackets, receivedBytes, droppedPackets, packetsPerSecond };
+}
+
 #define BUFSIZE 8192
+#define MAX_POOLED_DATAGRAMS 512
+
+UDPServer::DatagramPtr UDPServer::getDatagram() noexcept {
+	{
+		FastLock l(poolCS);
+		if (!freeDatagrams.empty()) {
+			auto datagram = move(freeDatagrams.back());
+			freeDatagrams.pop_back();
+			return datagram;
+		}
+	}
+
+	return make_shared<Socket::Datagram>(BUFSIZE);
+}
+
+void UDPServer::releaseDatagram(const DatagramPtr& aDatagram) noexcept {
+	FastLock l(poolCS);
+	if (freeDatagrams.size() < MAX_POOLED_DATAGRAMS) {
+		freeDatagrams.push_back(aDatagram);
+	}
+}
+
+void UDPServer::dispatchPacket(const DatagramPtr& aDatagram) noexcept {
+	receivedPackets++;
+	receivedBytes += aDatagram->len;
+
+	auto& worker = *workers[std::hash<string>()(aDatagram->ip) % workers.size()];
+	if (worker.pending >= MAX_PENDING_PACKETS) {
+		// Parsing can't keep up
+		droppedPackets++;
+		releaseDatagram(aDatagram);
+		return;
+	}
+
+	worker.pending++;
+	worker.queue.addTask([=, &worker] {
+		handlePacket(aDatagram->buf, aDatagram->len, aDatagram->ip);
+
+		worker.pending--;
+		releaseDatagram(aDatagram);
+	});
+}
+
 int UDPServer::run() {
-	int len;
-	string remoteAddr;
+	DatagramPtr batch[READ_BATCH_SIZE];
+	Socket::Datagram* batchPtrs[READ_BATCH_SIZE];
+
+	auto rateTick = GET_TICK();
+	uint64_t rateCount = 0;
 
 	while(!stop) {
+		auto tick = GET_TICK();
+		if (tick >= rateTick + 1000) {
+			uint64_t received = receivedPackets;
+			packetsPerSecond = (received - rateCount) * 1000 / (tick - rateTick);
+			rateTick = tick;
+			rateCount = received;
+		}
+
 		try {
 			if(!socket->wait(400, true, false).first) {
 				continue;
 			}
 
-			auto buf = vector<uint8_t>(BUFSIZE);
-			if((len = socket->read(buf.data(), BUFSIZE, remoteAddr)) > 0) {
-				pp.addTask([=] { handlePacket(buf, len, remoteAddr); });
+			// Read everything that has been queued
+			int count = 0;
+			int total = 0;
+			do {
+				for (int i = 0; i < READ_BATCH_SIZE; ++i) {
+					if (!batch[i]) {
+						batch[i] = getDatagram();
+					}
+
+					batchPtrs[i] = batch[i].get();
+				}
+
+				count = socket->readDatagrams(batchPtrs, READ_BATCH_SIZE);
+				for (int i = 0; i < count; ++i) {
+					if (batch[i]->len > 0) {
+						dispatchPacket(batch[i]);
+						batch[i] = nullptr;
+					}
+				}
+
+				total += max(count, 0);
+			} while (count == READ_BATCH_SIZE && !stop);
+
+			if (total > 0) {
 				continue;
 			}
 		} catch(const SocketException& e) {
@@ -20,6 +20,7 @@
 #define DCPLUSPLUS_DCPP_UDP_SERVER_H
 
 #include "AdcCommand.h"
+#include "CriticalSection.h"
 #include "DispatcherQueue.h"
 #include "Socket.h"
 
@@ -34,7 +35,14 @@ public:
 	void disconnect();
 	void listen();
 
+	struct Stats {
+		uint64_t receivedPackets;
+		uint64_t receivedBytes;
+		uint64_t droppedPackets;
+		uint64_t packetsPerSecond;
+	};
 
+	Stats getStats() const noexcept;
 private:
 	friend class CommandHandler<UDPServer>;
 
@@ -44,9 +52,39 @@ private:
 	string port;
 	bool stop;
 
-	DispatcherQueue pp;
+	typedef shared_ptr<Socket::Datagram> DatagramPtr;
+
+	// Maximum number of datagrams to read with a single call
+	static const int READ_BATCH_SIZE = 32;
+
+	// Packets waiting to be parsed by a single worker before new ones are dropped
+	static const int MAX_PENDING_PACKETS = 5000;
+
+	// Receive buffers are reused instead of allocating a new one for each packet
+	DatagramPtr getDatagram() noexcept;
+	void releaseDatagram(const DatagramPtr& aDatagram) noexcept;
+
+	vector<DatagramPtr> freeDatagrams;
+	FastCriticalSection poolCS;
+
+	struct Worker {
+		Worker() : queue(true) { }
+
+		DispatcherQueue queue;
+		atomic<int> pending { 0 };
+	};
+
+	// Packets from the same address are always parsed by the same worker so that their order is preserved
+	vector<unique_ptr<Worker>> workers;
+
+	void dispatchPacket(const DatagramPtr& aDatagram) noexcept;
 	void handlePacket(const ByteVector& aBuf, size_t aLen, const string& aRemoteIp);
 
+	atomic<uint64_t> receivedPackets { 0 };
+	atomic<uint64_t> receivedBytes { 0 };
+	atomic<uint64_t> droppedPackets { 0 };
+	atomic<uint64_t> packetsPerSecond { 0 };
+
 	// Search results
 	void handle(AdcCommand::RES, AdcCommand& c, const string& aRemoteIp) noexcept;
 
@@ -21,8 +21,6 @@
 
 #include "UserConnection.h"
 #include "Streams.h"
-#include "FilteredFile.h"
-#include "ZUtils.h"
 
 namespace dcpp {
 
@@ -36,8 +34,8 @@ InputStream* Upload::getStream() {
 	return stream.get(); 
 }
 
-void Upload::setFiltered() {
-	stream.reset(new FilteredInputStream<ZFilter, true>(stream.release()));
+void Upload::setFiltered(TransferCompression::Codec aCodec) {
+	stream.reset(TransferCompression::createCompressor(aCodec, stream.release()));
 	setFlag(Upload::FLAG_ZUPLOAD);
 }
 
@@ -24,6 +24,7 @@
 #include "UploadBundle.h"
 #include "Flags.h"
 #include "GetSet.h"
+#include "TransferCompression.h"
 #include "Util.h"
 
 namespace dcpp {
@@ -52,7 +53,7 @@ public:
 
 	uint8_t delayTime = 0;
 	InputStream* getStream();
-	void setFiltered();
+	void setFiltered(TransferCompression::Codec aCodec);
 	void resume(int64_t aStart, int64_t aSize) noexcept;
 
 	void appendFlags(OrderedStringSet& flags_) const noexcept;
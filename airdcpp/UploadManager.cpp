@@ -32,6 +32,7 @@
 #include "QueueManager.h"
 #include "ResourceManager.h"
 #include "ShareManager.h"
+#include "TransferCompression.h"
 #include "Upload.h"
 #include "UploadBundle.h"
 #include "UserConnection.h"
@@ -297,9 +298,9 @@ checkslots:
 					CryptoManager::getInstance()->decodeBZ2(reinterpret_cast<const uint8_t*>(bz2.data()), bz2.size(), xml);
 					// Clear to save some memory...
 					string().swap(bz2);
-					is.reset(new MemoryInputStream(xml));
-					start = 0;
 					fileSize = size = xml.size();
+					is.reset(new MemoryInputStream(move(xml)));
+					start = 0;
 				} else {
 					countFilePositions();
 					auto f = make_unique<File>(sourceFile, File::READ, File::OPEN | File::SHARED_WRITE); // write for partial sharing
@@ -941,6 +942,15 @@ void UploadManager::on(UserConnectionListener::Send, UserConnection* aSource) no
 	fire(UploadManagerListener::Starting(), u);
 }
 
+bool UploadManager::isCompressible(const Upload& aUpload, const string& aFile) noexcept {
+	switch (aUpload.getType()) {
+		case Transfer::TYPE_TREE: return false; // Hash data
+		case Transfer::TYPE_PARTIAL_LIST: return true; // Generated XML
+		case Transfer::TYPE_FULL_LIST: return aFile == Transfer::USER_LIST_NAME; // Unpacked from the bzipped list
+		default: return !TransferCompression::isCompressedExtension(aUpload.getPath());
+	}
+}
+
 void UploadManager::on(AdcCommand::GET, UserConnection* aSource, const AdcCommand& c) noexcept {
 	if(aSource->getState() != UserConnection::STATE_GET) {
 		dcdebug("UM::onGET Bad state, ignoring\n");
@@ -966,9 +976,10 @@ void UploadManager::on(AdcCommand::GET, UserConnection* aSource, const AdcComman
 			.addParam(Util::toString(u->getStartPos()))
 			.addParam(Util::toString(u->getSegmentSize()));
 
-		if(c.hasFlag("ZL", 4)) {
-			u->setFiltered();
-			cmd.addParam("ZL1");
+		auto codec = TransferCompression::parseCodec(c);
+		if (codec != TransferCompression::CODEC_NONE && isCompressible(*u, fname)) {
+			u->setFiltered(codec);
+			TransferCompression::addFlag(cmd, codec);
 		}
 		if(c.hasFlag("TL", 4) && type == Transfer::names[Transfer::TYPE_PARTIAL_LIST]) {
 			cmd.addParam("TL1");	 
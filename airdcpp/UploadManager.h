@@ -206,6 +206,10 @@ private:
 	void on(AdcCommand::GFI, UserConnection*, const AdcCommand&) noexcept;
 
 	bool prepareFile(UserConnection& aSource, const string& aType, const string& aFile, int64_t aResume, int64_t& aBytes, const string& userSID, bool listRecursive=false, bool tthList=false);
+
+	// Check whether it's worth to compress the upload (compressed formats won't benefit from it)
+	// aFile is the requested file name
+	static bool isCompressible(const Upload& aUpload, const string& aFile) noexcept;
 };
 
 } // namespace dcpp
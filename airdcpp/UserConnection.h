@@ -41,6 +41,7 @@ public:
 	static const string FEATURE_XML_BZLIST;
 	static const string FEATURE_ADCGET;
 	static const string FEATURE_ZLIB_GET;
+	static const string FEATURE_ZSTD_GET;
 	static const string FEATURE_TTHL;
 	static const string FEATURE_TTHF;
 	static const string FEATURE_ADC_BAS0;
@@ -78,7 +79,8 @@ public:
 		FLAG_SMALL_SLOT				= FLAG_MCN1 << 1,
 		FLAG_UBN1					= FLAG_SMALL_SLOT << 1,
 		FLAG_CPMI					= FLAG_UBN1 << 1,
-		FLAG_TRUSTED				= FLAG_CPMI << 1
+		FLAG_TRUSTED				= FLAG_CPMI << 1,
+		FLAG_SUPPORTS_ZSTD_GET		= FLAG_TRUSTED << 1
 
 	};
 	
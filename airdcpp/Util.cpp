@@ -32,6 +32,7 @@
 
 #include "FastAlloc.h"
 #include "File.h"
+#include "FormatTemplate.h"
 #include "LogManager.h"
 #include "ResourceManager.h"
 #include "SettingsManager.h"
@@ -1163,12 +1164,6 @@ string Util::encodeURI(const string& aString, bool reverse) noexcept {
 }
 
 
-// used to parse the boost::variant params of the formatParams function.
-struct GetString : boost::static_visitor<string> {
-	string operator()(const string& s) const noexcept { return s; }
-	string operator()(const std::function<string ()>& f) const noexcept { return f(); }
-};
-
 /**
  * This function takes a string and a set of parameters and transforms them according to
  * a simple formatting rule, similar to strftime. In the message, every parameter should be
@@ -1179,41 +1174,7 @@ struct GetString : boost::static_visitor<string> {
  */
 
 string Util::formatParams(const string& aMsg, const ParamMap& aParams, FilterF aFilter, time_t aTime) noexcept {
-	string result = aMsg;
-
-	string::size_type i, j, k;
-	i = 0;
-	while (( j = result.find("%[", i)) != string::npos) {
-		if( (result.size() < j + 2) || ((k = result.find(']', j + 2)) == string::npos) ) {
-			break;
-		}
-
-		auto param = aParams.find(result.substr(j + 2, k - j - 2));
-
-		if(param == aParams.end()) {
-			result.erase(j, k - j + 1);
-			i = j;
-
-		} else {
-			auto replacement = boost::apply_visitor(GetString(), param->second);
-
-			// replace all % in params with %% for strftime
-			replace("%", "%%", replacement);
-
-			if(aFilter) {
-				replacement = aFilter(replacement);
-			}
-
-			result.replace(j, k - j + 1, replacement);
-			i = j + replacement.size();
-		}
-	}
-
-	if (aTime > 0) {
-		result = formatTime(result, aTime);
-	}
-
-	return result;
+	return FormatTemplate::get(aMsg)->format(aParams, aFilter, aTime);
 }
 
 bool Util::isAdcDirectoryPath(const string& aPath) noexcept {
@@ -334,20 +334,29 @@ public:
 	static int pathSort(const string& a, const string& b) noexcept;
 
 	static int64_t toInt64(const string& aString) noexcept {
+		return toInt64(aString.c_str());
+	}
+	static int64_t toInt64(const char* c) noexcept {
 #ifdef _WIN32
-		return _atoi64(aString.c_str());
+		return _atoi64(c);
 #else
-		return strtoll(aString.c_str(), (char **)NULL, 10);
+		return strtoll(c, (char **)NULL, 10);
 #endif
 	}
 
 	static time_t toTimeT(const string& aString) noexcept {
 		return static_cast<time_t>(toInt64(aString));
 	}
+	static time_t toTimeT(const char* c) noexcept {
+		return static_cast<time_t>(toInt64(c));
+	}
 
 	static int toInt(const string& aString) noexcept {
 		return atoi(aString.c_str());
 	}
+	static int toInt(const char* c) noexcept {
+		return atoi(c);
+	}
 	static uint32_t toUInt32(const string& str) noexcept {
 		return toUInt32(str.c_str());
 	}
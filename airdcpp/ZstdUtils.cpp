@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2012-2019 AirDC++ Project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include "stdinc.h"
+
+#ifdef HAVE_ZSTD
+
+#include "ZstdUtils.h"
+
+#include "Exception.h"
+#include "ResourceManager.h"
+#include "SettingsManager.h"
+
+namespace dcpp {
+
+ZstdFilter::ZstdFilter() : ctx(ZSTD_createCCtx()) {
+	if (!ctx) {
+		throw Exception(STRING(COMPRESSION_ERROR));
+	}
+
+	// MAX_COMPRESSION is a zlib level (0-9), which maps reasonably well to the low zstd levels
+	if (ZSTD_isError(ZSTD_CCtx_setParameter(ctx, ZSTD_c_compressionLevel, max(SETTING(MAX_COMPRESSION), 1)))) {
+		ZSTD_freeCCtx(ctx);
+		throw Exception(STRING(COMPRESSION_ERROR));
+	}
+}
+
+ZstdFilter::~ZstdFilter() {
+	ZSTD_freeCCtx(ctx);
+}
+
+bool ZstdFilter::operator()(const void* in, size_t& insize, void* out, size_t& outsize) {
+	if(outsize == 0)
+		return false;
+
+	ZSTD_inBuffer input = { in, insize, 0 };
+	ZSTD_outBuffer output = { out, outsize, 0 };
+
+	auto ret = ZSTD_compressStream2(ctx, &output, &input, insize == 0 ? ZSTD_e_end : ZSTD_e_continue);
+	if (ZSTD_isError(ret))
+		throw Exception(STRING(COMPRESSION_ERROR));
+
+	outsize = output.pos;
+	insize = input.pos;
+
+	// When finishing, the return value tells the amount of data that is still to be flushed
+	return input.size > 0 || ret != 0;
+}
+
+UnZstdFilter::UnZstdFilter() : ctx(ZSTD_createDCtx()) {
+	if (!ctx) {
+		throw Exception(STRING(COMPRESSION_ERROR));
+	}
+}
+
+UnZstdFilter::~UnZstdFilter() {
+	ZSTD_freeDCtx(ctx);
+}
+
+bool UnZstdFilter::operator()(const void* in, size_t& insize, void* out, size_t& outsize) {
+	if(outsize == 0)
+		return false;
+
+	ZSTD_inBuffer input = { in, insize, 0 };
+	ZSTD_outBuffer output = { out, outsize, 0 };
+
+	auto ret = ZSTD_decompressStream(ctx, &output, &input);
+	if (ZSTD_isError(ret))
+		throw Exception(STRING(COMPRESSION_ERROR));
+
+	outsize = output.pos;
+	insize = input.pos;
+
+	// No more input and nothing left to flush (possibly a truncated frame)
+	if (input.size == 0 && output.pos == 0)
+		return false;
+
+	// Zero is returned when the frame has been fully decoded and flushed
+	return ret != 0;
+}
+
+} // namespace dcpp
+
+#endif
@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2012-2019 AirDC++ Project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef DCPLUSPLUS_DCPP_ZSTD_UTILS_H
+#define DCPLUSPLUS_DCPP_ZSTD_UTILS_H
+
+#ifdef HAVE_ZSTD
+
+#include <cstddef>
+
+#include <zstd.h>
+
+namespace dcpp {
+
+class ZstdFilter {
+public:
+	ZstdFilter();
+	~ZstdFilter();
+	/**
+	 * Compress data.
+	 * @param in Input data
+	 * @param insize Input size (Set to 0 to indicate that no more data will follow)
+	 * @param out Output buffer
+	 * @param outsize Output size, set to compressed size on return.
+	 * @return True if there's more processing to be done
+	 */
+	bool operator()(const void* in, size_t& insize, void* out, size_t& outsize);
+private:
+	ZSTD_CCtx* ctx;
+};
+
+class UnZstdFilter {
+public:
+	UnZstdFilter();
+	~UnZstdFilter();
+	/**
+	 * Decompress data.
+	 * @param in Input data
+	 * @param insize Input size (Set to 0 to indicate that no more data will follow)
+	 * @param out Output buffer
+	 * @param outsize Output size, set to decompressed size on return.
+	 * @return True if there's more processing to be done
+	 */
+	bool operator()(const void* in, size_t& insize, void* out, size_t& outsize);
+private:
+	ZSTD_DCtx* ctx;
+};
+
+} // namespace dcpp
+
+#endif
+
+#endif // !defined(DCPLUSPLUS_DCPP_ZSTD_UTILS_H)
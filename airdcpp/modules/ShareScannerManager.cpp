@@ -23,6 +23,7 @@
 #include <airdcpp/AirUtil.h>
 #include <airdcpp/FilteredFile.h>
 #include <airdcpp/File.h>
+#include <airdcpp/HashManager.h>
 #include <airdcpp/LogManager.h>
 #include <airdcpp/QueueManager.h>
 #include <airdcpp/ShareManager.h>
@@ -623,12 +624,17 @@ void ShareScannerManager::checkFileSFV(const string& aFileName, DirSFVReader& aS
 	uint64_t checkEnd = 0;
 
 	const auto fileNameLower = Text::toLower(aFileName);
-	if(aSfvReader.hasFile(fileNameLower)) {
+	auto sfvCrc = aSfvReader.hasFile(fileNameLower);
+	if(sfvCrc) {
 		// Perform the check
 		bool crcMatch = false;
 		try {
 			checkStart = GET_TICK();
-			crcMatch = aSfvReader.isCrcValid(fileNameLower);
+
+			// Avoid reading the file if it hasn't been modified after hashing
+			auto path = aSfvReader.getPath() + aFileName;
+			auto hashedCrc = HashManager::getInstance()->getFileCRC32(Text::toLower(path), path);
+			crcMatch = hashedCrc ? *hashedCrc == *sfvCrc : aSfvReader.isCrcValid(fileNameLower);
 			checkEnd = GET_TICK();
 		} catch(const FileException& ) {
 			// Couldn't read the file to get the CRC(!!!)
@@ -21,6 +21,7 @@
 
 #include <stdint.h>
 #include "forward.h"
+#include "LazyParam.h"
 
 #include "boost/variant.hpp"
 
@@ -104,7 +105,7 @@ typedef StringMapIter TStringMapIter;
 
 #endif
 
-typedef unordered_map<string, boost::variant<string, std::function<string ()>>> ParamMap;
+typedef unordered_map<string, boost::variant<string, LazyParam>> ParamMap;
 
 }
 
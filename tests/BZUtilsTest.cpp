@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) 2012-2019 AirDC++ Project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+// Checks that the parallel bzip2 decompressor produces the same output as the serial one
+// and that the streams it can't split are left for the serial decompressor
+
+#include "stdinc.h"
+
+#include "BZUtils.h"
+#include "FilteredFile.h"
+
+#include "TestUtil.h"
+
+#include <bzlib.h>
+
+using namespace dcpp;
+using namespace dcpp::test;
+
+// Mix of repetitive and random content (the random parts make false block headers possible)
+ByteVector createData(size_t aSize) {
+	ByteVector ret;
+	ret.reserve(aSize);
+
+	uint32_t state = 1;
+	for (int line = 0; ret.size() < aSize; ++line) {
+		string text = "<File Name=\"File " + Util::toString(line) + ".txt\" Size=\"" + Util::toString(line * 31) + "\"/>\n";
+		ret.insert(ret.end(), text.begin(), text.end());
+		for (int i = 0; i < 16; ++i) {
+			state = state * 1664525 + 1013904223;
+			ret.push_back(static_cast<uint8_t>(state >> 24));
+		}
+	}
+
+	ret.resize(aSize);
+	return ret;
+}
+
+ByteVector compress(const ByteVector& aData, int aLevel) {
+	ByteVector ret(aData.size() + aData.size() / 100 + 600);
+	auto len = static_cast<unsigned int>(ret.size());
+	CHECK(BZ2_bzBuffToBuffCompress(reinterpret_cast<char*>(&ret[0]), &len, const_cast<char*>(reinterpret_cast<const char*>(aData.data())),
+		static_cast<unsigned int>(aData.size()), aLevel, 0, 0) == BZ_OK);
+
+	ret.resize(len);
+	return ret;
+}
+
+ByteVector readAll(InputStream& aStream) {
+	ByteVector ret;
+	uint8_t buf[64 * 1024];
+	for (;;) {
+		size_t len = sizeof(buf);
+		auto n = aStream.read(buf, len);
+		if (n == 0) {
+			break;
+		}
+
+		ret.insert(ret.end(), buf, buf + n);
+	}
+
+	return ret;
+}
+
+void testParallel(size_t aSize, int aLevel) {
+	auto data = createData(aSize);
+	auto compressed = compress(data, aLevel);
+
+	ByteVector serial;
+	auto serialTime = measure([&] {
+		MemoryInputStream mis(compressed.data(), compressed.size());
+		FilteredInputStream<UnBZFilter, false> f(&mis);
+		serial = readAll(f);
+	});
+
+	CHECK(serial == data);
+
+	ParallelUnBZInputStream stream(compressed);
+	CHECK(stream.isSplit());
+
+	ByteVector parallel;
+	auto parallelTime = measure([&] {
+		parallel = readAll(stream);
+	});
+
+	CHECK(parallel == data);
+
+	// Segments allow random access to the decompressed data
+	uint64_t outPos = 0;
+	for (const auto& s: stream.getSegments()) {
+		CHECK(s.outStart == outPos);
+
+		// Only the bytes of the segment are needed
+		auto startByte = static_cast<size_t>(s.startBit / 8);
+		auto endByte = static_cast<size_t>((s.endBit + 7) / 8);
+		ByteVector segmentData(compressed.begin() + startByte, compressed.begin() + endByte);
+
+		ByteVector out;
+		CHECK(ParallelUnBZInputStream::decompressSegment(segmentData, stream.getLevel(), s, out));
+		CHECK(out.size() == s.outSize);
+		CHECK(equal(out.begin(), out.end(), data.begin() + static_cast<size_t>(s.outStart)));
+		outPos += s.outSize;
+	}
+
+	CHECK(outPos == data.size());
+
+	std::printf("%u bytes, level %d: %d segments, serial %.1f ms, parallel %.1f ms\n", static_cast<unsigned int>(aSize), aLevel,
+		static_cast<int>(stream.getSegments().size()), serialTime / 1000000, parallelTime / 1000000);
+}
+
+void testUnsplittable() {
+	// Single block
+	{
+		auto compressed = compress(createData(10 * 1000), 9);
+		CHECK(!ParallelUnBZInputStream(compressed).isSplit());
+	}
+
+	// Concatenated streams
+	{
+		auto compressed = compress(createData(1000 * 1000), 1);
+		auto second = compress(createData(500 * 1000), 1);
+		compressed.insert(compressed.end(), second.begin(), second.end());
+		CHECK(!ParallelUnBZInputStream(compressed).isSplit());
+	}
+
+	// Not bzip2 data
+	{
+		auto data = createData(1000 * 1000);
+		CHECK(!ParallelUnBZInputStream(data).isSplit());
+	}
+}
+
+int main() {
+	testUnsplittable();
+	testParallel(3 * 1000 * 1000, 1);
+	testParallel(5 * 1000 * 1000, 9);
+
+	std::printf("BZUtils: OK\n");
+	return 0;
+}
@@ -0,0 +1,171 @@
+/*
+ * Copyright (C) 2012-2019 AirDC++ Project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+// Loopback checks for the transfer compression codecs
+//
+// Data is sent through the compressor like an upload (read in socket buffer sized blocks)
+// and received through the decompressor like a download (written in packet sized blocks)
+
+#include "stdinc.h"
+
+#include "AdcCommand.h"
+#include "Encoder.h"
+#include "ResourceManager.h"
+#include "SettingsManager.h"
+#include "Streams.h"
+#include "TransferCompression.h"
+
+#include "TestUtil.h"
+
+using namespace dcpp;
+using namespace dcpp::test;
+
+typedef TransferCompression::Codec Codec;
+
+const size_t SEND_BLOCK_SIZE = 64 * 1024;
+const size_t RECEIVE_BLOCK_SIZE = 1460;
+
+string compress(Codec aCodec, const string& aData) {
+	unique_ptr<InputStream> is(TransferCompression::createCompressor(aCodec, new MemoryInputStream(aData)));
+
+	string ret;
+	string buf(SEND_BLOCK_SIZE, '\0');
+	for (;;) {
+		// len is set to the number of bytes consumed from the file, the compressed size is returned
+		size_t len = buf.size();
+		auto produced = is->read(&buf[0], len);
+		if (produced == 0) {
+			break;
+		}
+
+		ret.append(buf, 0, produced);
+	}
+
+	return ret;
+}
+
+string decompress(Codec aCodec, const string& aData) {
+	string ret;
+	unique_ptr<OutputStream> os(TransferCompression::createDecompressor(aCodec, new StringOutputStream(ret)));
+	for (size_t pos = 0; pos < aData.size(); pos += RECEIVE_BLOCK_SIZE) {
+		os->write(aData.data() + pos, min(RECEIVE_BLOCK_SIZE, aData.size() - pos));
+	}
+
+	os->flushBuffers(true);
+	return ret;
+}
+
+string createRandomData(size_t aSize, uint32_t aSeed) {
+	string ret(aSize, '\0');
+	uint32_t state = aSeed;
+	for (auto& c: ret) {
+		state = state * 1664525 + 1013904223;
+		c = static_cast<char>(state >> 24);
+	}
+
+	return ret;
+}
+
+string createListData(size_t aSize) {
+	string ret = "<?xml version=\"1.0\" encoding=\"utf-8\" standalone=\"yes\"?>\r\n<FileListing Version=\"1\" Base=\"/\">\r\n";
+	for (int i = 0; ret.size() < aSize; ++i) {
+		auto tth = createRandomData(24, i);
+		ret += "<File Name=\"Some.File.Name." + Util::toString(i) + ".mkv\" Size=\"" + Util::toString(i * 7919LL) + "\" TTH=\"" +
+			Encoder::toBase32(reinterpret_cast<const uint8_t*>(tth.data()), 24) + "\"/>\r\n";
+	}
+
+	return ret;
+}
+
+void testLoopback(Codec aCodec) {
+	auto flag = TransferCompression::getFlag(aCodec);
+
+	// Empty and tiny transfers
+	for (const auto& data: { string(), string("x") }) {
+		CHECK(decompress(aCodec, compress(aCodec, data)) == data);
+	}
+
+	// Compressible data
+	{
+		auto data = createListData(4 * 1024 * 1024);
+		string compressed;
+		auto ns = measure([&] { compressed = compress(aCodec, data); });
+
+		CHECK(decompress(aCodec, compressed) == data);
+
+		auto ratio = static_cast<double>(compressed.size()) / data.size();
+		std::printf("%s1: file list, %.3f of the original size, %.1f MiB/s\n", flag, ratio, data.size() / (ns / 1000000000.0) / (1024 * 1024));
+		CHECK(ratio < 0.5);
+	}
+
+	// Incompressible data mustn't grow much
+	{
+		auto data = createRandomData(4 * 1024 * 1024, 1);
+		string compressed;
+		auto ns = measure([&] { compressed = compress(aCodec, data); });
+
+		CHECK(decompress(aCodec, compressed) == data);
+
+		auto ratio = static_cast<double>(compressed.size()) / data.size();
+		std::printf("%s1: random data, %.3f of the original size, %.1f MiB/s\n", flag, ratio, data.size() / (ns / 1000000000.0) / (1024 * 1024));
+		CHECK(ratio < 1.01);
+	}
+}
+
+void testNegotiation() {
+	// Codec preferred by the uploader
+	{
+		AdcCommand cmd(AdcCommand::CMD_GET);
+		cmd.addParam("file").addParam("TTH/ABC").addParam("0").addParam("-1");
+		CHECK(TransferCompression::parseCodec(cmd) == TransferCompression::CODEC_NONE);
+
+		TransferCompression::addFlag(cmd, TransferCompression::CODEC_ZLIB);
+		CHECK(TransferCompression::parseCodec(cmd) == TransferCompression::CODEC_ZLIB);
+
+		TransferCompression::addFlag(cmd, TransferCompression::CODEC_ZSTD);
+		auto expected = TransferCompression::isSupported(TransferCompression::CODEC_ZSTD) ? TransferCompression::CODEC_ZSTD : TransferCompression::CODEC_ZLIB;
+		CHECK(TransferCompression::parseCodec(cmd) == expected);
+	}
+
+	// Formats that are compressed already
+	CHECK(TransferCompression::isCompressedExtension("/share/Movie.MKV"));
+	CHECK(TransferCompression::isCompressedExtension("/share/archive.r01"));
+	CHECK(TransferCompression::isCompressedExtension("files.xml.bz2"));
+	CHECK(!TransferCompression::isCompressedExtension("files.xml"));
+	CHECK(!TransferCompression::isCompressedExtension("/share/readme.txt"));
+	CHECK(!TransferCompression::isCompressedExtension("/share/noextension"));
+}
+
+int main() {
+	// The compression level is read from the settings
+	ResourceManager::newInstance();
+	SettingsManager::newInstance();
+
+	testNegotiation();
+	for (auto codec: { TransferCompression::CODEC_ZLIB, TransferCompression::CODEC_ZSTD }) {
+		if (TransferCompression::isSupported(codec)) {
+			testLoopback(codec);
+		}
+	}
+
+	SettingsManager::deleteInstance();
+	ResourceManager::deleteInstance();
+
+	std::printf("TransferCompression: OK\n");
+	return 0;
+}
@@ -0,0 +1,237 @@
+/*
+ * Copyright (C) 2012-2019 AirDC++ Project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+// Selection distribution and cost of PrioritySearchQueue
+//
+// The priority of each popped item must follow the weights of the items that can be searched for
+// (checked with a chi-squared test) and the items of a priority must be searched for in turns
+
+#include "stdinc.h"
+
+#include "Priority.h"
+#include "PrioritySearchQueue.h"
+#include "ResourceManager.h"
+#include "SettingsManager.h"
+
+#include "TestUtil.h"
+
+using namespace dcpp;
+using namespace dcpp::test;
+
+class TestItem {
+public:
+	TestItem(Priority aPriority, bool aAllowSearch) : priority(aPriority), allowSearch(aAllowSearch) { }
+
+	Priority getPriority() const noexcept { return priority; }
+	bool isRecent() const noexcept { return false; }
+	bool checkRecent() noexcept { return false; }
+	bool allowAutoSearch() const noexcept { return allowSearch; }
+
+	const Priority priority;
+	bool allowSearch;
+	int searches = 0;
+};
+
+typedef shared_ptr<TestItem> TestItemPtr;
+typedef PrioritySearchQueue<TestItemPtr> TestQueue;
+
+const int FIRST_PRIO = static_cast<int>(Priority::LOW);
+const int PRIO_COUNT = static_cast<int>(Priority::LAST) - FIRST_PRIO;
+
+// Critical value of the chi-squared distribution with 3 degrees of freedom (p = 0.001)
+const double CHI_SQUARED_CRITICAL = 16.27;
+
+// Deterministic item order
+uint32_t nextRandom(uint32_t& state_) {
+	state_ = state_ * 1664525 + 1013904223;
+	return state_ >> 8;
+}
+
+struct Population {
+	// Number of items for each priority (LOW...HIGHEST)
+	int items[PRIO_COUNT];
+
+	// Percentage of the items that can be searched for
+	int allowedPercent;
+};
+
+vector<TestItemPtr> createItems(const Population& aPopulation) {
+	vector<TestItemPtr> ret;
+	uint32_t state = 1;
+	for (int p = 0; p < PRIO_COUNT; p++) {
+		for (int i = 0; i < aPopulation.items[p]; i++) {
+			auto allowed = static_cast<int>(nextRandom(state) % 100) < aPopulation.allowedPercent;
+			ret.push_back(make_shared<TestItem>(static_cast<Priority>(FIRST_PRIO + p), allowed));
+		}
+	}
+
+	// Mix the priorities
+	for (auto i = ret.size(); i > 1; i--) {
+		swap(ret[i - 1], ret[nextRandom(state) % i]);
+	}
+
+	return ret;
+}
+
+void testDistribution(const char* aName, const Population& aPopulation, int aSearches) {
+	TestQueue queue(SettingsManager::BUNDLE_SEARCH_TIME);
+	auto items = createItems(aPopulation);
+	for (const auto& item: items) {
+		queue.addSearchPrio(item);
+	}
+
+	// Expected share of each priority
+	double weights[PRIO_COUNT] = { 0 };
+	double totalWeight = 0;
+	for (const auto& item: items) {
+		if (item->allowAutoSearch()) {
+			auto weight = static_cast<int>(item->getPriority()) - 1;
+			weights[static_cast<int>(item->getPriority()) - FIRST_PRIO] += weight;
+			totalWeight += weight;
+		}
+	}
+
+	int searches[PRIO_COUNT] = { 0 };
+	for (int i = 0; i < aSearches; i++) {
+		auto item = queue.maybePopSearchItem(GET_TICK(), true);
+		CHECK(item);
+		CHECK(item->allowAutoSearch());
+
+		item->searches++;
+		searches[static_cast<int>(item->getPriority()) - FIRST_PRIO]++;
+	}
+
+	double chiSquared = 0;
+	for (int p = 0; p < PRIO_COUNT; p++) {
+		auto expected = aSearches * weights[p] / totalWeight;
+		std::printf("%s: priority %s, expected %.0f, searched %d\n", aName, Util::toString(FIRST_PRIO + p).c_str(), expected, searches[p]);
+
+		CHECK(expected > 0 || searches[p] == 0);
+		if (expected > 0) {
+			chiSquared += (searches[p] - expected) * (searches[p] - expected) / expected;
+		}
+	}
+
+	std::printf("%s: chi-squared %.2f (critical value %.2f)\n", aName, chiSquared, CHI_SQUARED_CRITICAL);
+	CHECK(chiSquared < CHI_SQUARED_CRITICAL);
+
+	// Items of the same priority are searched for in turns
+	for (int p = 0; p < PRIO_COUNT; p++) {
+		int minSearches = numeric_limits<int>::max(), maxSearches = 0;
+		for (const auto& item: items) {
+			if (item->allowAutoSearch() && static_cast<int>(item->getPriority()) - FIRST_PRIO == p) {
+				minSearches = min(minSearches, item->searches);
+				maxSearches = max(maxSearches, item->searches);
+			} else if (!item->allowAutoSearch()) {
+				CHECK(item->searches == 0);
+			}
+		}
+
+		CHECK(minSearches == numeric_limits<int>::max() || maxSearches - minSearches <= 1);
+	}
+}
+
+void testRemoval() {
+	TestQueue queue(SettingsManager::BUNDLE_SEARCH_TIME);
+
+	Population population = { { 100, 100, 100, 100 }, 100 };
+	auto items = createItems(population);
+	for (const auto& item: items) {
+		queue.addSearchPrio(item);
+	}
+
+	// Remove every other item, including items that have already been searched for
+	for (int i = 0; i < 50; i++) {
+		queue.maybePopSearchItem(GET_TICK(), true);
+	}
+
+	for (size_t i = 0; i < items.size(); i += 2) {
+		queue.removeSearchPrio(items[i]);
+
+		// Removing twice is allowed
+		queue.removeSearchPrio(items[i]);
+		items[i]->searches = -1;
+	}
+
+	for (int i = 0; i < 10000; i++) {
+		auto item = queue.maybePopSearchItem(GET_TICK(), true);
+		CHECK(item);
+		CHECK(item->searches >= 0);
+	}
+
+	for (size_t i = 1; i < items.size(); i += 2) {
+		queue.removeSearchPrio(items[i]);
+	}
+
+	CHECK(!queue.maybePopSearchItem(GET_TICK(), true));
+}
+
+void benchmark(int aItemCount) {
+	const int searches = 100000;
+
+	TestQueue queue(SettingsManager::BUNDLE_SEARCH_TIME);
+	Population population = { { aItemCount / 2, aItemCount / 4, aItemCount / 8, aItemCount / 8 }, 90 };
+	auto items = createItems(population);
+
+	auto addNs = measure([&] {
+		for (const auto& item: items) {
+			queue.addSearchPrio(item);
+		}
+	});
+
+	auto popNs = measure([&] {
+		for (int i = 0; i < searches; i++) {
+			queue.maybePopSearchItem(GET_TICK(), true);
+		}
+	});
+
+	auto removeNs = measure([&] {
+		for (const auto& item: items) {
+			queue.removeSearchPrio(item);
+		}
+	});
+
+	std::printf("%d items: add %.0f ns, pop %.0f ns, remove %.0f ns\n", static_cast<int>(items.size()),
+		addNs / items.size(), popNs / searches, removeNs / items.size());
+}
+
+int main() {
+	// The search interval setting is read when items are added
+	ResourceManager::newInstance();
+	SettingsManager::newInstance();
+
+	// Most items can be searched for (sampled)
+	testDistribution("Sampled", { { 2000, 1000, 300, 50 }, 80 }, 200000);
+
+	// Most items can't be searched for (exact counting after the rejected samples)
+	testDistribution("Exact", { { 2000, 1000, 300, 50 }, 2 }, 20000);
+
+	// Empty priorities
+	testDistribution("Partial", { { 0, 500, 0, 20 }, 50 }, 20000);
+
+	testRemoval();
+
+	benchmark(10000);
+	benchmark(300000);
+
+	SettingsManager::deleteInstance();
+	ResourceManager::deleteInstance();
+
+	std::printf("PrioritySearchQueue: OK\n");
+	return 0;
+}
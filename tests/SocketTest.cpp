@@ -0,0 +1,205 @@
+/*
+ * Copyright (C) 2012-2019 AirDC++ Project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+// Socket event waiting with a large number of loopback connections
+//
+// The descriptors of the later connections exceed FD_SETSIZE (when the descriptor limit allows it),
+// which select can't handle. Disconnected and reset peers must be reported as ready so that the
+// following socket call notices the error.
+
+#include "stdinc.h"
+
+#include "ResourceManager.h"
+#include "SettingsManager.h"
+#include "Socket.h"
+
+#include "TestUtil.h"
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+using namespace dcpp;
+using namespace dcpp::test;
+
+const int MAX_CONNECTIONS = 700;
+const uint64_t WAIT_TIMEOUT = 5000;
+
+class TestSocket : public Socket {
+public:
+	TestSocket() : Socket(Socket::TYPE_TCP) {
+		setV4only(true);
+		setLocalIp4("127.0.0.1");
+	}
+
+	socket_t getDescriptor() const { return getSock(); }
+
+	// Send RST instead of FIN when the socket is closed
+	void setAbortiveClose() {
+		linger l = { 1, 0 };
+		CHECK(::setsockopt(getSock(), SOL_SOCKET, SO_LINGER, (char*)&l, sizeof(l)) == 0);
+	}
+};
+
+typedef unique_ptr<TestSocket> TestSocketPtr;
+
+struct Connection {
+	TestSocketPtr client;
+	TestSocketPtr server;
+};
+
+int getConnectionLimit() {
+#ifndef _WIN32
+	// Each connection uses two descriptors
+	rlimit limit;
+	if (getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+		limit.rlim_cur = limit.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &limit);
+		getrlimit(RLIMIT_NOFILE, &limit);
+		return static_cast<int>(min(static_cast<rlim_t>(MAX_CONNECTIONS), (limit.rlim_cur - 32) / 2));
+	}
+#endif
+
+	return MAX_CONNECTIONS;
+}
+
+Connection connect(TestSocket& aListener, const string& aPort) {
+	Connection ret = { make_unique<TestSocket>(), make_unique<TestSocket>() };
+	ret.client->connect(Socket::AddressInfo("127.0.0.1", Socket::AddressInfo::TYPE_V4), aPort);
+
+	CHECK(aListener.wait(WAIT_TIMEOUT, true, false).first);
+	ret.server->accept(aListener);
+	CHECK(ret.client->waitConnected(WAIT_TIMEOUT));
+	return ret;
+}
+
+void testTimeout(TestSocket& aSocket) {
+	auto ns = measure([&] {
+		auto ready = aSocket.wait(100, true, false);
+		CHECK(!ready.first && !ready.second);
+	});
+
+	CHECK_MSG(ns >= 90 * 1000000.0, "waited %.0f ms", ns / 1000000);
+}
+
+void testConnections(TestSocket& aListener, const string& aPort) {
+	auto connectionCount = getConnectionLimit();
+
+	vector<Connection> connections;
+	for (int i = 0; i < connectionCount; i++) {
+		connections.push_back(connect(aListener, aPort));
+	}
+
+	std::printf("%d connections, highest descriptor %d (FD_SETSIZE %d)\n", connectionCount,
+		static_cast<int>(connections.back().server->getDescriptor()), FD_SETSIZE);
+
+	// Nothing to read yet, all sockets can be written to
+	for (const auto& c: connections) {
+		auto ready = c.server->wait(0, true, true);
+		CHECK(!ready.first && ready.second);
+	}
+
+	testTimeout(*connections.back().server);
+
+	// Send data to every other connection
+	for (size_t i = 0; i < connections.size(); i += 2) {
+		connections[i].client->writeAll("x", 1, WAIT_TIMEOUT);
+	}
+
+	for (size_t i = 0; i < connections.size(); i++) {
+		auto ready = connections[i].server->wait(i % 2 == 0 ? WAIT_TIMEOUT : 0, true, false);
+		CHECK_MSG(ready.first == (i % 2 == 0), "connection %d", static_cast<int>(i));
+		CHECK(!ready.second);
+
+		if (ready.first) {
+			char c = 0;
+			CHECK(connections[i].server->read(&c, 1) == 1 && c == 'x');
+		}
+	}
+
+	// Close the clients in three different ways
+	for (size_t i = 0; i < connections.size(); i++) {
+		auto& client = *connections[i].client;
+		switch (i % 3) {
+			case 0: client.disconnect(); break; // FIN
+			case 1: client.setAbortiveClose(); client.close(); break; // RST
+			case 2: client.shutdown(); break; // FIN, the socket stays open
+		}
+	}
+
+	int resets = 0;
+	for (size_t i = 0; i < connections.size(); i++) {
+		auto& server = *connections[i].server;
+
+		// The peer going away must wake up a waiting reader
+		auto ready = server.wait(WAIT_TIMEOUT, true, false);
+		CHECK_MSG(ready.first, "connection %d", static_cast<int>(i));
+
+		char c = 0;
+		if (i % 3 == 1) {
+			try {
+				// The connection may also be reported as closed normally
+				CHECK(server.read(&c, 1) == 0);
+			} catch (const SocketException&) {
+				resets++;
+			}
+		} else {
+			CHECK(server.read(&c, 1) == 0);
+		}
+	}
+
+	std::printf("%d connections reset\n", resets);
+}
+
+void testRefused() {
+	// Reserve a port and close it
+	string port;
+	{
+		TestSocket s;
+		port = s.listen("0");
+	}
+
+	// The failure is reported as writable (POLLERR/POLLHUP) and waitConnected picks up the error
+	TestSocket client;
+	try {
+		client.connect(Socket::AddressInfo("127.0.0.1", Socket::AddressInfo::TYPE_V4), port);
+		client.waitConnected(WAIT_TIMEOUT);
+		CHECK_MSG(false, "connecting to a closed port succeeded");
+	} catch (const SocketException& e) {
+		std::printf("Closed port: %s\n", e.getError().c_str());
+	}
+}
+
+int main() {
+	ResourceManager::newInstance();
+	SettingsManager::newInstance();
+
+	{
+		TestSocket listener;
+		auto port = listener.listen("0");
+		testConnections(listener, port);
+	}
+
+	testRefused();
+
+	SettingsManager::deleteInstance();
+	ResourceManager::deleteInstance();
+
+	std::printf("Socket: OK\n");
+	return 0;
+}
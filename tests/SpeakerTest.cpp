@@ -0,0 +1,247 @@
+/*
+ * Copyright (C) 2012-2019 AirDC++ Project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+// Checks the listener removal guarantees of Speaker and compares the dispatch cost
+// with the previous implementation (listener list copied under a lock for each fire)
+
+#include "stdinc.h"
+
+#include "Speaker.h"
+
+#include "TestUtil.h"
+
+#include <atomic>
+#include <thread>
+
+using namespace dcpp;
+using namespace dcpp::test;
+
+class TestListener {
+public:
+	virtual ~TestListener() { }
+	template<int I>	struct X { enum { TYPE = I }; };
+
+	typedef X<0> Event;
+
+	virtual void on(Event, int) noexcept { }
+};
+
+class TestSpeaker : public Speaker<TestListener> {
+public:
+	void event(int aValue) noexcept {
+		fire(TestListener::Event(), aValue);
+	}
+};
+
+// Dispatching of the old implementation
+class LockingSpeaker {
+public:
+	void addListener(TestListener* aListener) {
+		Lock l(cs);
+		listeners.push_back(aListener);
+	}
+
+	void event(int aValue) noexcept {
+		Lock l(cs);
+		tmpListeners = listeners;
+		for (auto listener: tmpListeners) {
+			listener->on(TestListener::Event(), aValue);
+		}
+	}
+private:
+	vector<TestListener*> listeners;
+	vector<TestListener*> tmpListeners;
+	CriticalSection cs;
+};
+
+class CountingListener : public TestListener {
+public:
+	void on(Event, int) noexcept override {
+		// A listener must never be called after its removal has returned
+		CHECK(!removed);
+		calls++;
+	}
+
+	std::atomic<bool> removed { false };
+	std::atomic<int> calls { 0 };
+};
+
+// Removes and "deletes" itself inside the handler
+class SelfRemovingListener : public TestListener {
+public:
+	explicit SelfRemovingListener(TestSpeaker& aSpeaker) : speaker(aSpeaker) { }
+
+	void on(Event, int) noexcept override {
+		CHECK(!deleted);
+		if (!removing.exchange(true)) {
+			speaker.removeListener(this);
+			deleted = true;
+		}
+	}
+
+	std::atomic<bool> removing { false };
+	std::atomic<bool> deleted { false };
+private:
+	TestSpeaker& speaker;
+};
+
+template<class SpeakerT>
+double benchmarkFire(SpeakerT& aSpeaker, int aThreads, int aFires) {
+	auto ns = measure([&] {
+		vector<std::thread> threads;
+		for (int t = 0; t < aThreads; ++t) {
+			threads.emplace_back([&] {
+				for (int i = 0; i < aFires; ++i) {
+					aSpeaker.event(i);
+				}
+			});
+		}
+
+		for (auto& t: threads) {
+			t.join();
+		}
+	});
+
+	return ns / (static_cast<double>(aThreads) * aFires);
+}
+
+void benchmark() {
+	const int LISTENERS = 8;
+	const int FIRES = 200000;
+
+	vector<TestListener> listeners(LISTENERS);
+
+	TestSpeaker speaker;
+	LockingSpeaker lockingSpeaker;
+	for (auto& l: listeners) {
+		speaker.addListener(&l);
+		lockingSpeaker.addListener(&l);
+	}
+
+	for (auto threads: { 1, 2, 4, 8 }) {
+		auto cow = benchmarkFire(speaker, threads, FIRES / threads);
+		auto locking = benchmarkFire(lockingSpeaker, threads, FIRES / threads);
+		std::printf("fire, %d listeners, %d threads: %.1f ns (locking: %.1f ns)\n", LISTENERS, threads, cow, locking);
+	}
+
+	speaker.removeListeners();
+}
+
+// Remove listeners while other threads keep firing
+void testRemoveWhileFiring() {
+	const int ROUNDS = 2000;
+
+	TestSpeaker speaker;
+	std::atomic<bool> stop { false };
+
+	vector<std::thread> threads;
+	for (int t = 0; t < 4; ++t) {
+		threads.emplace_back([&] {
+			while (!stop) {
+				speaker.event(0);
+			}
+		});
+	}
+
+	for (int i = 0; i < ROUNDS; ++i) {
+		CountingListener l;
+		speaker.addListener(&l);
+		while (l.calls == 0) {
+			std::this_thread::yield();
+		}
+
+		speaker.removeListener(&l);
+		l.removed = true;
+		CHECK(!speaker.hasListener(&l));
+	}
+
+	stop = true;
+	for (auto& t: threads) {
+		t.join();
+	}
+
+	CHECK(speaker.getListenerCount() == 0);
+}
+
+// "removeListener(this); delete this;" inside a handler while other threads are dispatching the same listener
+void testSelfRemovalWhileFiring() {
+	const int ROUNDS = 2000;
+
+	TestSpeaker speaker;
+	for (int i = 0; i < ROUNDS; ++i) {
+		SelfRemovingListener l(speaker);
+		speaker.addListener(&l);
+
+		vector<std::thread> threads;
+		for (int t = 0; t < 4; ++t) {
+			threads.emplace_back([&] {
+				for (int j = 0; j < 10; ++j) {
+					speaker.event(j);
+				}
+			});
+		}
+
+		for (auto& t: threads) {
+			t.join();
+		}
+
+		CHECK(l.deleted);
+		CHECK(!speaker.hasListener(&l));
+	}
+}
+
+// Several threads removing listeners inside handlers of the same speaker mustn't deadlock
+void testConcurrentRemovalInHandlers() {
+	const int ROUNDS = 2000;
+
+	TestSpeaker speaker;
+	for (int i = 0; i < ROUNDS; ++i) {
+		vector<std::unique_ptr<SelfRemovingListener>> listeners;
+		for (int l = 0; l < 4; ++l) {
+			listeners.push_back(std::make_unique<SelfRemovingListener>(speaker));
+			speaker.addListener(listeners.back().get());
+		}
+
+		vector<std::thread> threads;
+		for (int t = 0; t < 4; ++t) {
+			threads.emplace_back([&] {
+				speaker.event(0);
+			});
+		}
+
+		for (auto& t: threads) {
+			t.join();
+		}
+
+		for (auto& l: listeners) {
+			CHECK(l->deleted);
+		}
+
+		CHECK(speaker.getListenerCount() == 0);
+	}
+}
+
+int main() {
+	testRemoveWhileFiring();
+	testSelfRemovalWhileFiring();
+	testConcurrentRemovalInHandlers();
+	benchmark();
+
+	std::printf("Speaker: OK\n");
+	return 0;
+}
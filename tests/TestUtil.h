@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2012-2019 AirDC++ Project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef DCPLUSPLUS_TESTS_TESTUTIL_H_
+#define DCPLUSPLUS_TESTS_TESTUTIL_H_
+
+// Minimal helpers for the standalone checks
+// Each check is an executable that returns a non-zero exit code on failure
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#define CHECK(expr) \
+	do { \
+		if (!(expr)) { \
+			std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #expr); \
+			std::exit(1); \
+		} \
+	} while (false)
+
+#define CHECK_MSG(expr, ...) \
+	do { \
+		if (!(expr)) { \
+			std::fprintf(stderr, "%s:%d: check failed: %s: ", __FILE__, __LINE__, #expr); \
+			std::fprintf(stderr, __VA_ARGS__); \
+			std::fprintf(stderr, "\n"); \
+			std::exit(1); \
+		} \
+	} while (false)
+
+namespace dcpp {
+namespace test {
+
+// Runs the function and returns the elapsed time in nanoseconds
+template<class F>
+double measure(F&& aF) {
+	auto start = std::chrono::steady_clock::now();
+	aF();
+	return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+}
+
+} // namespace test
+} // namespace dcpp
+
+#endif // DCPLUSPLUS_TESTS_TESTUTIL_H_
@@ -0,0 +1,181 @@
+/*
+ * Copyright (C) 2012-2019 AirDC++ Project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+// Deterministic simulation of upload limiting with the token bucket of ThrottleManager
+//
+// Connections share one bucket and try to send on every simulated millisecond like BufferedSocket does.
+// The simulated socket blocks (-1) or sends only a part of the data now and then; a blocked write is
+// retried with the same buffer directly with the socket (the OpenSSL workaround of BufferedSocket).
+// Checks that the limit holds and that the connections get an even share of it.
+
+#include "stdinc.h"
+
+#include "ThrottleManager.h"
+
+#include "TestUtil.h"
+
+using namespace dcpp;
+using namespace dcpp::test;
+
+typedef ThrottleManager::TokenBucket TokenBucket;
+
+// Maximum amount of unused tokens that can be accumulated (ms), see ThrottleManager.cpp
+const int64_t MAX_BURST_TIME = 100;
+
+// Deterministic pseudo random numbers
+class Random {
+public:
+	explicit Random(uint32_t aSeed) : state(aSeed) { }
+
+	uint32_t next() {
+		state = state * 1664525 + 1013904223;
+		return state >> 8;
+	}
+
+	bool chance(int aPercent) {
+		return static_cast<int>(next() % 100) < aPercent;
+	}
+private:
+	uint32_t state;
+};
+
+struct Connection {
+	int64_t sent = 0;
+	uint64_t waitUntil = 0;
+
+	// Size of a blocked write that must be retried
+	int pendingRetry = 0;
+};
+
+struct Result {
+	int64_t total = 0;
+	double fairness = 0;
+};
+
+// Jain's fairness index (1 = equal shares)
+double getFairness(const vector<Connection>& aConnections) {
+	double sum = 0, squares = 0;
+	for (const auto& c: aConnections) {
+		sum += c.sent;
+		squares += static_cast<double>(c.sent) * c.sent;
+	}
+
+	return squares == 0 ? 0 : (sum * sum) / (aConnections.size() * squares);
+}
+
+// aLegacyRefund: return the tokens of blocked writes as well (the previous behavior)
+Result simulate(int64_t aRate, int aConnections, int aBlockPercent, int aPartialPercent, uint64_t aDuration, bool aLegacyRefund) {
+	const int64_t WRITE_SIZE = 64 * 1024;
+
+	TokenBucket bucket;
+	Random random(12345);
+	vector<Connection> connections(aConnections);
+
+	auto write = [&](int aSize) {
+		if (random.chance(aBlockPercent)) {
+			return -1;
+		}
+
+		return random.chance(aPartialPercent) ? aSize / 2 : aSize;
+	};
+
+	for (uint64_t tick = 1; tick <= aDuration; ++tick) {
+		// The threads are scheduled in a varying order
+		auto first = random.next() % aConnections;
+		for (int i = 0; i < aConnections; ++i) {
+			auto& c = connections[(first + i) % aConnections];
+			if (c.waitUntil > tick) {
+				continue;
+			}
+
+			if (c.pendingRetry > 0) {
+				// Retried without the limiter
+				auto sent = write(c.pendingRetry);
+				if (sent > 0) {
+					c.sent += sent;
+					c.pendingRetry = 0;
+				}
+
+				continue;
+			}
+
+			auto wanted = min(WRITE_SIZE, ThrottleManager::getSlice(aRate, aConnections));
+			auto granted = bucket.consume(wanted, aRate, tick);
+			if (granted == 0) {
+				auto waitTime = bucket.getWaitTime(wanted, aRate);
+				c.waitUntil = tick + max(static_cast<uint64_t>(1), min(waitTime, static_cast<uint64_t>(250)));
+				continue;
+			}
+
+			auto sent = write(static_cast<int>(granted));
+			if (aLegacyRefund) {
+				if (sent < granted) {
+					bucket.refund(granted - max(sent, 0));
+				}
+			} else {
+				bucket.settleWrite(granted, sent);
+			}
+
+			if (sent > 0) {
+				c.sent += sent;
+			} else {
+				c.pendingRetry = static_cast<int>(granted);
+			}
+		}
+	}
+
+	Result ret;
+	for (const auto& c: connections) {
+		ret.total += c.sent;
+	}
+
+	ret.fairness = getFairness(connections);
+	return ret;
+}
+
+void testLimit(int64_t aRate, int aConnections, int aBlockPercent, int aPartialPercent) {
+	// Long enough for each connection to get at least 100 slices (fairness can't be measured with less)
+	auto slices = aRate * 20 / ThrottleManager::getSlice(aRate, aConnections);
+	auto duration = static_cast<uint64_t>(20000 * max(static_cast<int64_t>(1), (100 * aConnections + slices - 1) / slices));
+
+	auto expected = aRate * static_cast<int64_t>(duration) / 1000;
+	auto maxAllowed = aRate * static_cast<int64_t>(duration + MAX_BURST_TIME) / 1000;
+
+	auto result = simulate(aRate, aConnections, aBlockPercent, aPartialPercent, duration, false);
+	auto legacy = simulate(aRate, aConnections, aBlockPercent, aPartialPercent, duration, true);
+
+	auto accuracy = static_cast<double>(result.total) / expected;
+	std::printf("%lld B/s, %d connections, %d%% blocked, %d%% partial, %llu s: %.4f of the limit, fairness %.4f (refunding blocked writes: %.4f)\n",
+		static_cast<long long>(aRate), aConnections, aBlockPercent, aPartialPercent, static_cast<unsigned long long>(duration / 1000), accuracy, result.fairness, static_cast<double>(legacy.total) / expected);
+
+	CHECK_MSG(result.total <= maxAllowed, "sent %lld bytes, allowed %lld", static_cast<long long>(result.total), static_cast<long long>(maxAllowed));
+	CHECK_MSG(accuracy >= 0.95, "only %.4f of the limit was used", accuracy);
+	CHECK_MSG(result.fairness >= 0.98, "fairness index %.4f", result.fairness);
+}
+
+int main() {
+	for (auto rate: { 10 * 1024LL, 100 * 1024LL, 10 * 1024 * 1024LL }) {
+		for (auto connections: { 1, 4, 32 }) {
+			testLimit(rate, connections, 0, 0);
+			testLimit(rate, connections, 20, 10);
+		}
+	}
+
+	std::printf("ThrottleManager: OK\n");
+	return 0;
+}